@@ -0,0 +1,147 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "llcomp.hpp"
+
+namespace llcomp {
+
+/// Sizes of one coded file; `raw` is the uncompressed side in both directions.
+struct BatchResult {
+    uint64_t raw = 0;
+    uint64_t compressed = 0;
+};
+
+/**
+ * @brief Expands the file arguments of a command line tool.
+ *
+ * A directory stands for the regular files directly inside it for which `accept` returns
+ * true, and "-" for the paths read from stdin, one per line.
+ */
+template <typename Accept>
+inline std::vector<std::string> collectFiles(const std::vector<std::string>& args, Accept&& accept) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> files;
+    for (const auto& arg : args) {
+        if (arg == "-") {
+            for (std::string line; std::getline(std::cin, line);) {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (!line.empty()) files.push_back(line);
+            }
+        } else if (fs::is_directory(arg)) {
+            std::vector<std::string> entries;
+            for (const auto& entry : fs::directory_iterator(arg)) {
+                if (entry.is_regular_file() && accept(entry.path())) entries.push_back(entry.path().string());
+            }
+            std::sort(entries.begin(), entries.end());
+            files.insert(files.end(), entries.begin(), entries.end());
+        } else {
+            files.push_back(arg);
+        }
+    }
+    return files;
+}
+
+/**
+ * @brief Sets the initial states of `options` from the argument of `--states`: "default",
+ *        "trained", or the path of a table written by `llcomp_train --out`.
+ *
+ * @return false when the table cannot be read.
+ */
+inline bool parseStates(const std::string& arg, EncodeOptions& options) {
+    options.custom_states.clear();
+    if (arg == "default" || arg == "trained") {
+        options.initial_states = arg == "default" ? InitialStates::Default : InitialStates::Trained;
+        return true;
+    }
+    std::ifstream in(arg, std::ios::binary);
+    options.custom_states.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    options.initial_states = InitialStates::Custom;
+    return !options.custom_states.empty();
+}
+
+/// Output of `--stats`, which needs a build with LLCOMP_STATS.
+enum class StatsFormat { None, Text, Json };
+
+/**
+ * @brief Prints the CodecStats of one file to stdout, as a text block or as one JSON line.
+ *
+ * Files coded on several workers are printed one at a time.
+ */
+inline void printStats(const std::string& file, const CodecStats& stats, StatsFormat format) {
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (format == StatsFormat::Json) {
+        std::string name;
+        for (const char c : file) {
+            if (c == '"' || c == '\\') {
+                name += '\\';
+                name += c;
+            } else if (uint8_t(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", unsigned(c));
+                name += escaped;
+            } else {
+                name += c;
+            }
+        }
+        std::cout << "{\"file\": \"" << name << "\", \"stats\": " << stats.json() << "}" << std::endl;
+    } else {
+        std::cout << file << ":\n" << stats.text() << std::flush;
+    }
+}
+
+/**
+ * @brief Codes every file on a pool and prints the totals and the failures.
+ *
+ * A worker takes one file at a time, so the pool size bounds the files in flight and
+ * with them the memory held. `code` is called as `BatchResult(const std::string&)` and
+ * reports a failure by throwing.
+ *
+ * @return Number of failed files.
+ */
+template <typename Code>
+inline size_t runBatch(const std::vector<std::string>& files, ThreadPool& pool, Code&& code) {
+    std::vector<BatchResult> results(files.size());
+    std::vector<std::string> errors(files.size());
+    const auto start = std::chrono::steady_clock::now();
+    pool.parallel_for(files.size(), [&](size_t i) {
+        try {
+            results[i] = code(files[i]);
+        } catch (const std::exception& e) {
+            errors[i] = e.what();
+        }
+    });
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    BatchResult total;
+    size_t failed = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!errors[i].empty()) {
+            ++failed;
+            continue;
+        }
+        total.raw += results[i].raw;
+        total.compressed += results[i].compressed;
+    }
+    char line[256];
+    std::snprintf(line, sizeof(line), "%zu files (%zu failed) in %.2f s, %u threads: %.1f MB raw, %.1f MB compressed, ratio %.3f, %.1f MB/s\n",
+                  files.size(), failed, seconds, unsigned(pool.size()), total.raw / 1e6, total.compressed / 1e6,
+                  total.compressed ? double(total.raw) / total.compressed : 0.0, seconds > 0 ? total.raw / 1e6 / seconds : 0.0);
+    std::cout << line;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!errors[i].empty()) std::cerr << "Failed: " << files[i] << ": " << errors[i] << std::endl;
+    }
+    return failed;
+}
+
+} // namespace llcomp
@@ -13,26 +13,236 @@
 #include <functional>
 #include <utility>
 #include <type_traits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <deque>
+#include <optional>
+#include <cstring>
+#include <climits>
+#include <chrono>
+#include <cstdio>
+#include "llcomp_states.hpp"
+
+#if !defined(LLCOMP_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define LLCOMP_X86_SIMD 1
+#include <immintrin.h>
+#endif
 
 namespace llcomp {
 constexpr inline auto ext = ".llcomp";
-constexpr inline uint8_t revision = 2;
+constexpr inline uint8_t revision = 3;
 constexpr inline uint8_t magic_revision = 0x77 + revision;
-constexpr inline bool LargeModel = true;
+constexpr inline uint8_t magic_revision_v2 = 0x77 + 2; // single slice, still decoded
+constexpr inline uint8_t magic_sequence = 0x76; // container of SequenceEncoder
 constexpr inline int param_e_lim = 4;  //0,1,2,3,4
 constexpr inline int param_r_lim = 6;  //5,6
 constexpr inline int param_s_bit = 7;  //7
 constexpr inline int substates_nb = 8; //=
-constexpr size_t getStatesNb() {
-    if constexpr (LargeModel) {
-        return (11 * 11 * 11 * 5 * 5 + 1) / 2 * substates_nb;
-    } else {
-        return (11 * 11 * 11 + 1) / 2 * substates_nb;
+// samples above 8 bits, whose residual exponents reach 17
+constexpr inline int deep_e_lim = 12;  //0,1..12
+constexpr inline int deep_r_lim = 14;  //13,14
+constexpr inline int deep_s_bit = 15;  //15
+constexpr inline int deep_substates_nb = 16;
+
+/**
+ * @brief Contexts of binarization::putSymbol() for a residual, and the states a context
+ *        holds for them.
+ *
+ * Samples above 8 bits give each exponent bit up to 11 a state of its own: their
+ * residuals are depth - 8 bits longer, and a shared state for the long unary prefix
+ * adapts to neither its ones nor its final zero.
+ */
+template <bool Deep>
+struct SymbolContexts {
+    static constexpr int e_lim = Deep ? deep_e_lim : param_e_lim;
+    static constexpr int r_lim = Deep ? deep_r_lim : param_r_lim;
+    static constexpr int s_bit = Deep ? deep_s_bit : param_s_bit;
+    static constexpr int substates = Deep ? deep_substates_nb : substates_nb;
+};
+
+/**
+ * @brief Context models, selected per image and stored in the header.
+ *
+ * Tiny:  quant5 of the three first-order gradients, 63 contexts.
+ * Small: quant11 of the three first-order gradients, 666 contexts.
+ * Large: Small plus quant5 of the two distance-2 gradients. These are weighted by
+ *        5*11*11 and 5*5*11*11, which overlap the Small range, so |hash| <= 7925.
+ */
+enum class Model : uint8_t {
+    Tiny = 0,
+    Small = 1,
+    Large = 2,
+};
+constexpr inline int models_nb = 3;
+
+constexpr size_t getContextsNb(Model model) {
+    switch (model) {
+        case Model::Tiny: return (5 * 5 * 5 + 1) / 2;
+        case Model::Small: return (11 * 11 * 11 + 1) / 2;
+        default: return 5 + 5 * 11 + 5 * 11 * 11 + 2 * 5 * 11 * 11 + 2 * 5 * 5 * 11 * 11 + 1;
+    }
+}
+
+constexpr size_t getStatesNb(Model model, int bit_depth = 8) {
+    return getContextsNb(model) * (bit_depth > 8 ? deep_substates_nb : substates_nb);
+}
+
+constexpr const char* modelName(Model model) {
+    switch (model) {
+        case Model::Tiny: return "tiny";
+        case Model::Small: return "small";
+        default: return "large";
+    }
+}
+
+/**
+ * @brief Default model for a slice of `samples` samples.
+ *
+ * A context only pays off once it has seen enough symbols to adapt, so small slices
+ * spread their statistics over fewer contexts. Large stays the default for big slices,
+ * where its distance-2 gradients win clearly on gradients and screen content.
+ */
+constexpr Model pickModel(uint64_t samples) {
+    if (samples < 4096) return Model::Tiny;
+    if (samples < 32768) return Model::Small;
+    return Model::Large;
+}
+
+/**
+ * @brief Entropy coder of the residuals, recorded in the header flags.
+ *
+ * Range:      RangeEncoder with the adaptive binarization, the default.
+ * WideRange:  WideRangeEncoder, same binarization and states.
+ * GolombRice: GolombRiceEncoder with one adaptive k per context, a speed tier that
+ *             trades some ratio for a much cheaper inner loop.
+ */
+enum class Coder : uint8_t {
+    Range = 0,
+    WideRange = 1,
+    GolombRice = 2,
+};
+
+constexpr const char* coderName(Coder coder) {
+    switch (coder) {
+        case Coder::Range: return "range";
+        case Coder::WideRange: return "wide";
+        default: return "golomb";
+    }
+}
+
+/**
+ * @brief Where the residual states of the range coders start, recorded in the header.
+ *
+ * Default: every state at 0, p = 0.5.
+ * Trained: the built-in table of trainedStates(), for the models small slices pick.
+ * Custom:  a table stored in the header, e.g. one trained by llcomp_train on the
+ *          caller's own corpus.
+ *
+ * A slice otherwise spends its first thousands of decisions learning the statistics
+ * every slice shares, which is most of a small image. Golomb-Rice slices always start
+ * from their default states.
+ */
+enum class InitialStates : uint8_t {
+    Default = 0,
+    Trained = 1,
+    Custom = 2,
+};
+
+constexpr const char* initialStatesName(InitialStates states) {
+    switch (states) {
+        case InitialStates::Default: return "default";
+        case InitialStates::Trained: return "trained";
+        default: return "custom";
+    }
+}
+
+/**
+ * @brief Built-in initial states of `model`, getStatesNb() of them, or nullptr.
+ *
+ * llcomp_train generates the tables in llcomp_states.hpp. Only the 8-bit Tiny and Small
+ * models have one: those are the models of slices small enough for the initial states to
+ * matter, and a Large table would be 62 KiB.
+ */
+constexpr const uint8_t* trainedStates(Model model, int bit_depth = 8) {
+    if (bit_depth > 8) return nullptr;
+    switch (model) {
+        case Model::Tiny: return trained_tiny_states.data();
+        case Model::Small: return trained_small_states.data();
+        default: return nullptr;
+    }
+}
+static_assert(trained_tiny_states.size() == getStatesNb(Model::Tiny) && trained_small_states.size() == getStatesNb(Model::Small),
+              "llcomp_states.hpp does not match the context models");
+
+/**
+ * @brief Prediction of a sample from its causal neighbours, one per row of a stream with
+ *        adaptive predictors.
+ *
+ * Med:      LOCO-I median of left, top and the planar gradient, used by every row of other
+ *           streams.
+ * Gradient: CALIC gradient-adjusted prediction, which follows horizontal and vertical
+ *           edges by comparing the gradient energy in both directions.
+ * Left:     the left sample, for rows made of horizontal structures.
+ * Top:      the sample above, for vertical structures.
+ * Average:  mean of left and top, for noisy smooth areas.
+ */
+enum class Predictor : uint8_t {
+    Med = 0,
+    Gradient = 1,
+    Left = 2,
+    Top = 3,
+    Average = 4,
+};
+
+constexpr inline int predictors_nb = 5;
+
+constexpr const char* predictorName(Predictor predictor) {
+    switch (predictor) {
+        case Predictor::Med: return "med";
+        case Predictor::Gradient: return "gradient";
+        case Predictor::Left: return "left";
+        case Predictor::Top: return "top";
+        default: return "average";
+    }
+}
+
+/**
+ * @brief Calls `pick(predictor)` with the predictor as a std::integral_constant, so a row
+ *        runs a kernel specialized for it.
+ */
+template <typename Pick>
+inline auto pickPredictorKernel(Predictor predictor, Pick&& pick) {
+    switch (predictor) {
+        case Predictor::Gradient: return pick(std::integral_constant<Predictor, Predictor::Gradient>{});
+        case Predictor::Left: return pick(std::integral_constant<Predictor, Predictor::Left>{});
+        case Predictor::Top: return pick(std::integral_constant<Predictor, Predictor::Top>{});
+        case Predictor::Average: return pick(std::integral_constant<Predictor, Predictor::Average>{});
+        default: return pick(std::integral_constant<Predictor, Predictor::Med>{});
     }
 }
+
+/**
+ * @brief Binary range encoder.
+ *
+ * @tparam PutByte Callable `void(uint8_t)` receiving the coded bytes. It is stored by
+ *                 value so the byte sink is inlined into the coding loop.
+ */
+template <typename PutByte>
 class RangeEncoder {
 public:
-    RangeEncoder(std::function<void(uint8_t)> put_byte): low(0), range(0xFF00), put_byte(put_byte), outstanding_count(0), outstanding_byte(-1) {
+    explicit RangeEncoder(PutByte put_byte): outstanding_count(0), outstanding_byte(-1), low(0), range(0xFF00), put_byte(std::move(put_byte)) {
+    }
+
+    /// Starts a new stream on the same byte sink.
+    void reset() {
+        outstanding_count = 0;
+        outstanding_byte = -1;
+        low = 0;
+        range = 0xFF00;
     }
 
     void renorm_encoder() {
@@ -85,14 +295,33 @@ private:
     int outstanding_byte;
     int low;
     int range;
-    std::function<void(char)> put_byte;
+    PutByte put_byte;
 };
 
+/**
+ * @brief Binary range decoder matching RangeEncoder.
+ *
+ * @tparam GetByte Callable `uint8_t()` returning the next coded byte.
+ */
+template <typename GetByte>
 class RangeDecoder {
 public:
-    RangeDecoder(std::function<uint8_t()> get_byte) : get_byte(get_byte), range(0xFF00) {
-        low = this->get_byte() << 8;
-        low |= this->get_byte();
+    RangeDecoder() = default;
+
+    explicit RangeDecoder(GetByte get_byte) : get_byte(std::move(get_byte)) {
+        reset();
+    }
+
+    /// Starts decoding a new stream from `get_byte`.
+    void reset(GetByte get_byte) {
+        this->get_byte = std::move(get_byte);
+        reset();
+    }
+
+    void reset() {
+        range = 0xFF00;
+        low = get_byte() << 8;
+        low |= get_byte();
     }
 
     void refill() {
@@ -121,9 +350,129 @@ public:
     }
 
 private:
-    int range;
-    int low;
-    std::function<int()> get_byte;
+    int range = 0;
+    int low = 0;
+    GetByte get_byte;
+};
+
+/**
+ * @brief Binary range encoder with a 32-bit range, renormalized 16 bits at a time.
+ *
+ * Same interval split as RangeEncoder, but the range only drops below 2^16 every 16 or so
+ * coded bits, and a carry is resolved once per output word: a word that could still take
+ * a carry (0xFFFF) is counted instead of written, as in LZMA.
+ *
+ * @tparam PutByte Callable `void(uint8_t)` receiving the coded bytes.
+ */
+template <typename PutByte>
+class WideRangeEncoder {
+public:
+    explicit WideRangeEncoder(PutByte put_byte) : put_byte(std::move(put_byte)) {
+    }
+
+    /// Starts a new stream on the same byte sink.
+    void reset() {
+        low = 0;
+        range = 0xFFFFFFFF;
+        cache = 0;
+        pending = 0;
+        first = true;
+    }
+
+    void put(bool bit, uint8_t probability) {
+        const uint32_t range1 = uint32_t(uint64_t(range) * probability >> 8);
+        assert(range1 > 0 && range1 < range);
+        if (!bit) {
+            range -= range1;
+        } else {
+            low += range - range1;
+            range = range1;
+        }
+        if (range < 0x10000) {
+            // one decision takes at most 6 bits, so a single shift restores the range
+            shiftLow();
+            range <<= 16;
+        }
+    }
+
+    void finish() {
+        // the top 32 bits of low go out, then the word still held in the cache
+        for (int i = 0; i < 3; ++i) {
+            shiftLow();
+        }
+    }
+
+private:
+    void shiftLow() {
+        if (first) {
+            // the coded value stays below 1.0, so the first word never takes a carry
+            cache = uint32_t(low >> 16);
+            first = false;
+        } else if (low < 0xFFFF0000 || low >= 0x100000000) {
+            const uint32_t carry = uint32_t(low >> 32);
+            putWord(cache + carry);
+            for (; pending; --pending) {
+                putWord(0xFFFF + carry);
+            }
+            cache = uint32_t(low >> 16) & 0xFFFF;
+        } else {
+            ++pending;
+        }
+        low = (low & 0xFFFF) << 16;
+    }
+
+    void putWord(uint32_t word) {
+        put_byte(uint8_t(word >> 8));
+        put_byte(uint8_t(word));
+    }
+
+    uint64_t low = 0;
+    uint32_t range = 0xFFFFFFFF;
+    uint32_t cache = 0;
+    uint64_t pending = 0;
+    bool first = true;
+    PutByte put_byte;
+};
+
+/**
+ * @brief Binary range decoder matching WideRangeEncoder.
+ *
+ * @tparam GetByte Byte source with a `uint32_t read16()` member returning the next two
+ *                 bytes big endian, so the source checks its bounds once per word.
+ */
+template <typename GetByte>
+class WideRangeDecoder {
+public:
+    WideRangeDecoder() = default;
+
+    /// Starts decoding a new stream from `get_byte`.
+    void reset(GetByte get_byte) {
+        this->get_byte = std::move(get_byte);
+        range = 0xFFFFFFFF;
+        code = this->get_byte.read16() << 16;
+        code |= this->get_byte.read16();
+    }
+
+    bool get(uint8_t probability) {
+        const uint32_t range1 = uint32_t(uint64_t(range) * probability >> 8);
+        range -= range1;
+        bool bit = false;
+        if (code >= range) {
+            code -= range;
+            range = range1;
+            bit = true;
+        }
+        if (range < 0x10000) {
+            range <<= 16;
+            code = (code << 16) | get_byte.read16();
+        }
+        return bit;
+    }
+
+private:
+    uint32_t range = 0;
+    uint32_t code = 0;
+    GetByte get_byte;
 };
 
 namespace binarization {
@@ -159,19 +508,21 @@ namespace binarization {
      * @param r_limit The maximum value for the remainder context. Default is 7.
      * @param sign_ctx The context for the sign bit. Default is 7.
      * @param v The value to encode.
-     * @param putRac A callback function to handle the binary arithmetic coding.
+     * @param putRac A callable handling the binary arithmetic coding.
      *               It takes two parameters: the context (int) and the binary value (bool).
-     *               If the callback is null, the function does nothing.
+     *               If the callable is testable and null, the function does nothing.
      */
-    template <bool isSigned, int e_limit=4, int r_limit=7, int sign_ctx=7, typename T>
-    inline void putSymbol(T v, std::function<void(int, bool)> putRac) {
+    template <bool isSigned, int e_limit=4, int r_limit=7, int sign_ctx=7, typename T, typename PutRac>
+    inline void putSymbol(T v, PutRac&& putRac) {
 
         if constexpr (!std::is_integral_v<T>) {
             throw std::invalid_argument("putSymbol requires an integral type");
         }
 
-        if (!putRac) {
-            return;
+        if constexpr (std::is_constructible_v<bool, const std::decay_t<PutRac>&>) {
+            if (!putRac) {
+                return;
+            }
         }
         uint32_t uv;
         if constexpr (std::is_signed_v<T>) {
@@ -211,16 +562,18 @@ namespace binarization {
      * @param e_limit The maximum value for the exponent context. Default is 4.
      * @param r_limit The maximum value for the remainder context. Default is 7.
      * @param sign_ctx The context for the sign bit. Default is 7.
-     * @param getRac A function that returns a boolean value based on the context.
+     * @param getRac A callable that returns a boolean value based on the context.
      *               It takes an integer context as input and returns a boolean value.
      * @return The decoded symbol as an integer.
-     * @throws std::runtime_error If the decoded exponent exceeds 31, indicating invalid data.
+     * @throws std::runtime_error If the decoded exponent overflows the value type, indicating invalid data.
      */
-    template <bool isSigned, int e_limit=4, int r_limit=7, int sign_ctx=7>
-    inline auto getSymbol(std::function<bool(int)> getRac) {
+    template <bool isSigned, int e_limit=4, int r_limit=7, int sign_ctx=7, typename GetRac>
+    inline auto getSymbol(GetRac&& getRac) {
 
         std::conditional_t<isSigned, int32_t, uint32_t> value{0};
-        if (!getRac) return value; // If the callback is null, return zero.
+        if constexpr (std::is_constructible_v<bool, const std::decay_t<GetRac>&>) {
+            if (!getRac) return value; // If the callback is null, return zero.
+        }
 
         if (getRac(0)) return value;
 
@@ -229,7 +582,7 @@ namespace binarization {
         value = 1;
         while (getRac(std::min(ctx++, e_limit))) {
             e++;
-            if (e > 31) {
+            if (e > (isSigned ? 30 : 31)) {
                 throw std::runtime_error("Invalid exponent");
             }
         }
@@ -293,8 +646,222 @@ namespace cabac {
         };
     }
 
+namespace golomb {
+    /**
+     * @brief Adaptive Golomb-Rice parameter of one context, as in FFV1 and JPEG-LS.
+     *
+     * `error_sum / count` tracks the mean magnitude and gives k; `bias` follows the mean
+     * residual and is subtracted before coding, with `drift` accumulating what is left.
+     */
+    struct State {
+        int32_t error_sum = 4;
+        int16_t drift = 0;
+        int8_t bias = 0;
+        uint8_t count = 1;
+
+        int k() const {
+            int k = 0;
+            for (int i = count; i < error_sum; i += i) ++k;
+            return k;
+        }
+
+        /// Sign of the remaining drift, folded into the coded value: 0 or -1.
+        int flip() const {
+            return (2 * drift + count) >> 31;
+        }
+
+        void update(int v) {
+            int d = drift + v;
+            int n = count;
+            error_sum += v < 0 ? -v : v;
+            if (n == 128) {
+                n >>= 1;
+                d >>= 1;
+                error_sum >>= 1;
+            }
+            ++n;
+            if (d <= -n) {
+                if (bias > -128) --bias;
+                d += n;
+                if (d <= -n) d = -n + 1;
+            } else if (d > 0) {
+                if (bias < 127) ++bias;
+                d -= n;
+                if (d > 0) d = 0;
+            }
+            drift = int16_t(d);
+            count = uint8_t(n);
+        }
+    };
+
+    /// A quotient of `limit` zeros escapes to the mapped value in escapeBits() bits.
+    constexpr inline int limit = 12;
+
+    /**
+     * @brief Bits of an escaped value for samples of `bit_depth` bits.
+     *
+     * Residuals stay within +-(2^(depth + 1) - 2) and the bias within +-128, so mapped
+     * values fit depth + 3 bits: 11 for 8-bit samples.
+     */
+    constexpr int escapeBits(int bit_depth) {
+        return bit_depth + 3;
+    }
+
+    /**
+     * @brief Bits of the unary prefix and of the suffix of the code of `residual` in
+     *        `state`, as GolombRiceEncoder::put() writes it.
+     */
+    inline std::pair<int, int> codeLength(int residual, const State& state, int bit_depth = 8) {
+        const int k = state.k();
+        const int code = (residual - state.bias) ^ state.flip();
+        const uint32_t mapped = code < 0 ? -2 * code - 1 : 2 * code;
+        if (int(mapped >> k) < limit) return {int(mapped >> k) + 1, k};
+        return {limit, escapeBits(bit_depth)};
+    }
+}
+
+/**
+ * @brief Golomb-Rice coder for the residuals, written MSB first through a 64-bit buffer.
+ *
+ * A residual takes at most `golomb::limit + golomb::escapeBits(bit_depth)` bits, 31 at most.
+ *
+ * @tparam PutByte Callable `void(uint8_t)` receiving the coded bytes.
+ */
+template <typename PutByte>
+class GolombRiceEncoder {
+public:
+    explicit GolombRiceEncoder(PutByte put_byte) : put_byte(std::move(put_byte)) {
+    }
+
+    /// Starts a new stream on the same byte sink.
+    void reset() {
+        buffer = 0;
+        bits = 0;
+    }
+
+    /// Sizes the escaped values for samples of `bit_depth` bits.
+    void setBitDepth(int bit_depth) {
+        escape_bits = golomb::escapeBits(bit_depth);
+    }
+
+    void put(int residual, golomb::State& state) {
+        const int k = state.k();
+        const int v = residual - state.bias;
+        const int code = v ^ state.flip();
+        const uint32_t mapped = code < 0 ? -2 * code - 1 : 2 * code;
+        if (int(mapped >> k) < golomb::limit) {
+            putBits(int(mapped >> k) + 1 + k, (uint64_t(1) << k) | (mapped & ((1u << k) - 1)));
+        } else {
+            assert(mapped < 1u << escape_bits);
+            putBits(golomb::limit + escape_bits, mapped);
+        }
+        state.update(v);
+    }
+
+    void finish() {
+        // pad the last byte with zeros
+        putBits(7, 0);
+        for (; bits >= 8; bits -= 8) {
+            put_byte(uint8_t(buffer >> (bits - 8)));
+        }
+    }
+
+    /// Writes the low `n` bits of `value`, n <= 32.
+    void putBits(int n, uint64_t value) {
+        buffer = buffer << n | value;
+        bits += n;
+        if (bits >= 32) {
+            bits -= 32;
+            const uint32_t word = uint32_t(buffer >> bits);
+            put_byte(uint8_t(word >> 24));
+            put_byte(uint8_t(word >> 16));
+            put_byte(uint8_t(word >> 8));
+            put_byte(uint8_t(word));
+        }
+    }
+
+    uint64_t buffer = 0;
+    int bits = 0;
+    int escape_bits = golomb::escapeBits(8);
+    PutByte put_byte;
+};
+
+/**
+ * @brief Decoder matching GolombRiceEncoder.
+ *
+ * @tparam GetByte Byte source with a `uint32_t read16()` member, as for WideRangeDecoder.
+ */
+template <typename GetByte>
+class GolombRiceDecoder {
+public:
+    GolombRiceDecoder() = default;
+
+    /// Starts decoding a new stream from `get_byte`.
+    void reset(GetByte get_byte) {
+        this->get_byte = std::move(get_byte);
+        buffer = 0;
+        bits = 0;
+    }
+
+    /// See GolombRiceEncoder::setBitDepth().
+    void setBitDepth(int bit_depth) {
+        escape_bits = golomb::escapeBits(bit_depth);
+    }
+
+    int get(golomb::State& state) {
+        const int k = state.k();
+        refill();
+        // the buffer holds at least 49 bits, enough for the whole code
+        const uint32_t top = uint32_t(buffer >> 32);
+        const int zeros = top ? 31 - int(binarization::ilog2_32<binarization::UnsafeBehavior>(top)) : 32;
+        uint32_t mapped;
+        if (zeros < golomb::limit) {
+            skip(zeros + 1);
+            mapped = uint32_t(zeros) << k | take(k);
+        } else {
+            skip(golomb::limit);
+            mapped = take(escape_bits);
+        }
+        const int v = int(mapped >> 1) ^ -int(mapped & 1) ^ state.flip();
+        const int residual = v + state.bias;
+        state.update(v);
+        return residual;
+    }
+
+    /// Reads `n` bits, n <= 32.
+    uint32_t getBits(int n) {
+        refill();
+        return take(n);
+    }
+
+private:
+    void refill() {
+        while (bits <= 48) {
+            buffer |= uint64_t(get_byte.read16()) << (48 - bits);
+            bits += 16;
+        }
+    }
+
+    void skip(int n) {
+        buffer <<= n;
+        bits -= n;
+    }
+
+    uint32_t take(int n) {
+        if (n == 0) return 0;
+        const uint32_t value = uint32_t(buffer >> (64 - n));
+        skip(n);
+        return value;
+    }
+
+    uint64_t buffer = 0;
+    int bits = 0;
+    int escape_bits = golomb::escapeBits(8);
+    GetByte get_byte;
+};
+
 
-inline const std::vector<int> quant5_table = {
+constexpr inline std::array<int, 256> quant5_table = {
     0, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
     2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
     2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
@@ -313,7 +880,7 @@ inline const std::vector<int> quant5_table = {
     -2, -2, -2, -2, -2, -2, -2, -2, -2, -2, -2, -2, -2, -1, -1, -1,
 };
 
-inline const std::vector<int> quant11_table = {
+constexpr inline std::array<int, 256> quant11_table = {
     0, 1, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4,
     4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
     4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
@@ -355,194 +922,4497 @@ inline int median(int a, int b, int c) {
     return b;
 }
 
-inline std::vector<uint8_t> compressImage(const std::vector<uint8_t>& rgb, int width, int height, int channels) {
-    int size = width * height * channels;
-    int stride = width * channels;
-    assert(size == rgb.size());
-    std::vector<uint8_t> buffer(size);
-    int write_pos = 0;
-    int read_pos = 0;
-
-    auto writeU8 = [&](uint8_t x) {
-        buffer[write_pos++] = x;
-    };
-
-    auto writeU16 = [&](uint16_t x) {
-        buffer[write_pos++] = x & 0xFF;
-        buffer[write_pos++] = (x >> 8) & 0xFF;
-    };
+/**
+ * @brief Minimal fixed-size thread pool used to code slices concurrently.
+ *
+ * `parallel_for` blocks until every index has been processed. The calling thread
+ * takes part in the work, so nested calls from inside a task cannot deadlock.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency()) {
+        for (unsigned i = 1; i < std::max(1u, threads); ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
 
-    writeU8(magic_revision);
-    writeU8(channels);
-    writeU16(width);
-    writeU16(height);
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
 
-    RangeEncoder comp([&](char x) {
-        writeU8(x);
-    });
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
 
-    std::vector<std::vector<int16_t>> lines(3, std::vector<int16_t>(stride));
-    std::vector<cabac::State> states( getStatesNb() );
-    int pos = 0;
-    const int x1 = channels;
-    const int x2 = channels * 2;
+    size_t size() const { return workers.size() + 1; }
 
-    for (int h = 0; h < height; ++h) {
-        auto& line0 = lines[h % 3];
-        auto& line1 = lines[(h + 3 - 1) % 3];
-        auto& line2 = lines[(h + 3 - 2) % 3];
-        for (int w = 0; w < width; ++w) {
-            const int x = w * channels;
-            if (channels >= 3) {
-                int r = rgb[pos];
-                int g = rgb[pos + 1];
-                int b = rgb[pos + 2];
-                b -= g;
-                r -= g;
-                g += (b + r) / 4;
+    static ThreadPool& shared() {
+        static ThreadPool pool;
+        return pool;
+    }
 
-                line0[x + 0] = r;
-                line0[x + 1] = g;
-                line0[x + 2] = b;
-                for (int i = 3; i < channels; i++) {
-                    line0[x + i] = rgb[pos + i];
+    template <typename F>
+    void parallel_for(size_t n, F&& fn) {
+        if (n == 0) return;
+        if (n == 1 || workers.empty()) {
+            for (size_t i = 0; i < n; ++i) fn(i);
+            return;
+        }
+        struct Job {
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> done{0};
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::exception_ptr error;
+        };
+        auto job = std::make_shared<Job>();
+        auto run = [job, n, &fn] {
+            for (size_t i; (i = job->next++) < n;) {
+                try {
+                    fn(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(job->mutex);
+                    if (!job->error) job->error = std::current_exception();
                 }
-            } else {
-                for (int i = 0; i < channels; i++) {
-                    line0[x + i] = rgb[pos + i];
+                if (++job->done == n) {
+                    std::lock_guard<std::mutex> lock(job->mutex);
+                    job->cv.notify_all();
                 }
             }
-            pos += channels;
-            for (int i = 0; i < channels; i++) {
-                const int l = w > 0 ? line0[x - x1 + i] : h > 0 ? line1[x + i] : 128;
-                const int t = h > 0 ? line1[x + i] : l;
-                const int L = w > 1 ? line0[x - x2 + i] : l;
-                const int tl = h > 0 && w > 0 ? line1[x - x1 + i] : t;
-                const int tr = h > 0 && w < (width - 1) ? line1[x + x1 + i] : t;
-                const int T = h > 1 ? line2[x + i] : t;
-
-                int hash = (quant11(l - tl) +
-                    quant11(tl - t) * (11) +
-                    quant11(t - tr) * (11 * 11));
-                if (LargeModel) {
-                    hash += quant5(L - l) * (5 * 11 * 11) + quant5(T - t) * (5 * 5 * 11 * 11);
-                }
-                const int predict = median(l, l + t - tl, t);
-                int diff = (line0[x + i] - predict);
-
-                if (hash < 0) {
-                    hash = -hash;
-                    diff = -diff;
-                }
-                assert(hash >= 0);
-
-                binarization::putSymbol<true,param_e_lim,param_r_lim,param_s_bit>(diff,[&](int ctx, bool bit) {
-                   auto base = states.begin() +  hash * substates_nb;
-                   auto& state = base[ctx];
-                   comp.put(bit, state.P());
-                   state.update(bit);
-                });
+        };
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 1; i < std::min(n, size()); ++i) {
+                tasks.emplace_back(run);
+            }
+        }
+        cv.notify_all();
+        run();
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->cv.wait(lock, [&] { return job->done == n; });
+        if (job->error) std::rethrow_exception(job->error);
+    }
 
+private:
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
             }
+            task();
         }
     }
-    comp.finish();
-    buffer.resize(write_pos);
-    return buffer;
-}
 
-struct RawImage {
-    std::vector<uint8_t> pixels;
-    uint16_t width;
-    uint16_t height;
-    uint8_t channels;
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping{false};
 };
 
-inline RawImage decompressImage(const std::vector<uint8_t>& data) {
-    size_t pos = 0;
-    const uint8_t magic = data[pos++];
-    //assert((magic & 0xFF) == 0x77 && "Invalid magic number");
-    if ((magic & 0xFF) != magic_revision) {
-        throw std::runtime_error("Invalid magic number");
-    }
-    const uint8_t channels = data[pos++];
-    const uint16_t width = (data[pos] | (data[pos + 1] << 8)); pos += 2;
-    const uint16_t height = (data[pos] | (data[pos + 1] << 8)); pos += 2;
-    const size_t stride = width * channels;
-    std::vector<uint8_t> pixels(width * height * channels);
-    size_t rgb_pos = 0;
-
-    RangeDecoder decomp([&]() -> uint8_t {
-        if (pos >= data.size())
-            return 0;
-        return data[pos++];
-    });
-
-    const int x1 = channels;
-    const int x2 = channels * 2;
-    std::vector<std::vector<int16_t>> lines(3, std::vector<int16_t>(stride));
-    std::vector<cabac::State> states( getStatesNb() );
-
-    for (size_t h = 0; h < height; ++h) {
-        auto& line0 = lines[h % 3];
-        auto& line1 = lines[(h + 2) % 3];
-        auto& line2 = lines[(h + 1) % 3];
-
-        for (size_t w = 0; w < width; ++w) {
-            const size_t x = w * channels;
-            for (size_t i = 0; i < channels; ++i) {
-                const int l = w > 0 ? line0[x - x1 + i] : (h > 0 ? line1[x + i] : 128);
-                const int t = h > 0 ? line1[x + i] : l;
-                const int L = w > 1 ? line0[x - x2 + i] : l;
-                const int tl = h > 0 && w > 0 ? line1[x - x1 + i] : t;
-                const int tr = h > 0 && w < width - 1 ? line1[x + x1 + i] : t;
-                const int T = h > 1 ? line2[x + i] : t;
-
-                int hash = (quant11(l - tl) +
-                    quant11(tl - t) * 11 +
-                    quant11(t - tr) * 11 * 11);
-
-                if (LargeModel) {
-                    hash += quant5(L - l) * (5 * 11 * 11) + quant5(T - t) * (5 * 5 * 11 * 11);
-                }
+struct CodecStats;
 
-                const int predict = median(l, l + t - tl, t);
+struct EncodeOptions {
+    int slice_cols = 1; // slices are laid out as a slice_cols x slice_rows grid, 1..65535 each
+    int slice_rows = 1;
+    std::vector<uint8_t> metadata; // opaque bytes stored in the header
+    ThreadPool* pool = nullptr; // nullptr = ThreadPool::shared()
+    std::optional<Model> model; // unset = pickModel() on the samples per slice
+    Coder coder = Coder::Range;
+    bool run_mode = true; // code runs of identical pixels in flat areas, JPEG-LS style
+    bool wavefront = false; // one substream per row, decodable in parallel; needs a 1x1 slice grid
+    bool planar = false; // one substream per colour-transformed channel, coded in parallel
+    bool adaptive_predictor = false; // pick a Predictor per row instead of MED everywhere
+    InitialStates initial_states = InitialStates::Default; // Trained falls back to Default for models without a built-in table
+    std::vector<uint8_t> custom_states; // table of InitialStates::Custom, see trainStates(); unset model = the model of its size
+    int bit_depth = 8; // 8 for uint8_t samples, 9..16 for uint16_t samples, which must stay below 2^bit_depth
+    CodecStats* stats = nullptr; // receives the instrumentation of builds with LLCOMP_STATS
+};
 
-                bool neg_diff = false;
-                if (hash < 0) {
-                    hash = -hash;
-                    neg_diff = true;
-                }
+/**
+ * @brief Where decompressInto() puts the samples: interleaved rows, or one plane per
+ *        channel, with any row stride, e.g. the padded rows of a texture or a PNG encoder.
+ *
+ * Samples of streams above 8 bits are native-endian `uint16_t`; the strides stay in bytes
+ * and must then be even, like the address of `pixels`.
+ */
+struct OutputLayout {
+    uint8_t* pixels = nullptr; // first sample of the image, of its first plane if planar
+    size_t capacity = 0; // bytes available at `pixels`
+    size_t row_stride = 0; // bytes from a row to the next
+    size_t plane_stride = 0; // bytes from a plane to the next; 0 = interleaved samples
+};
 
-                int diff = binarization::getSymbol<true,param_e_lim,param_r_lim, param_s_bit>([&](int ctx) {
-                    auto base = states.begin() +  hash * substates_nb;
-                    auto& state = base[ctx];
-                    bool bit = decomp.get(state.P());
-                    state.update(bit);
-                    return bit;
-                 });
+struct Rect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
 
+/**
+ * @brief Rectangle covered by slice (sx, sy) of a cols x rows grid, FFV1 style.
+ */
+inline Rect sliceRect(int width, int height, int cols, int rows, int sx, int sy) {
+    const int x0 = static_cast<int>(int64_t(width) * sx / cols);
+    const int x1 = static_cast<int>(int64_t(width) * (sx + 1) / cols);
+    const int y0 = static_cast<int>(int64_t(height) * sy / rows);
+    const int y1 = static_cast<int>(int64_t(height) * (sy + 1) / rows);
+    return {x0, y0, x1 - x0, y1 - y0};
+}
 
-                if (neg_diff) {
-                    diff = -diff;
-                }
-                line0[x + i] = predict + diff;
-            }
+/**
+ * @brief Packs the initial states of an InitialStates::Custom header into `out`.
+ *
+ * States come in the order of ContextStates::bins, `substates` per context. Each is
+ * coded as its difference to the same state of the previous context, modulo 128 and
+ * zigzag mapped to 7 bits. A byte below 128 holds one difference; 128 + n stands for
+ * n + 1 zero differences, as in the runs of rare contexts left at state 0.
+ */
+inline void packStates(const std::vector<uint8_t>& states, int substates, std::vector<uint8_t>& out) {
+    out.clear();
+    int zeros = 0;
+    auto flush = [&] {
+        for (; zeros > 0; zeros -= 128) out.push_back(uint8_t(128 + std::min(zeros, 128) - 1));
+        zeros = 0;
+    };
+    for (size_t i = 0; i < states.size(); ++i) {
+        const int prev = i >= size_t(substates) ? states[i - substates] : 0;
+        const int d = ((states[i] - prev) & 127) - ((states[i] - prev) & 64 ? 128 : 0);
+        if (d == 0) {
+            ++zeros;
+            continue;
+        }
+        flush();
+        out.push_back(uint8_t(d > 0 ? 2 * d : -2 * d - 1));
+    }
+    flush();
+}
 
-            int r = line0[x + 0];
-            int g = line0[x + 1];
-            int b = line0[x + 2];
-            g -= ((r + b) / 4);
-            r += g;
-            b += g;
-            pixels[rgb_pos++] = std::max(0, std::min(255, r));
-            pixels[rgb_pos++] = std::max(0, std::min(255, g));
-            pixels[rgb_pos++] = std::max(0, std::min(255, b));
-            for (size_t i = 3; i < channels; ++i) {
-                pixels[rgb_pos++] = line0[x + i];
-            }
+/**
+ * @brief Inverse of packStates(), expecting `count` states.
+ */
+inline void unpackStates(const std::vector<uint8_t>& packed, size_t count, int substates, std::vector<uint8_t>& states) {
+    states.clear();
+    states.reserve(count);
+    auto push = [&](int d) {
+        if (states.size() == count) {
+            throw std::runtime_error("Invalid initial states");
+        }
+        const size_t i = states.size();
+        states.push_back(uint8_t(((i >= size_t(substates) ? states[i - substates] : 0) + d) & 127));
+    };
+    for (uint8_t b : packed) {
+        if (b < 128) {
+            push(b & 1 ? -(b >> 1) - 1 : b >> 1);
+        } else {
+            for (int n = b - 127; n > 0; --n) push(0);
         }
     }
-    return {std::move(pixels), width, height, channels};
+    if (states.size() != count) {
+        throw std::runtime_error("Invalid initial states");
+    }
 }
+
+/**
+ * @brief Container header.
+ *
+ * Revision 3 layout, little endian:
+ *
+ *     u8  magic_revision
+ *     u8  flags                  bit 0: slice index present
+ *                                bit 1: slices coded with WideRangeEncoder
+ *                                bit 2: slices coded with GolombRiceEncoder
+ *                                bit 3: run mode for flat areas
+ *                                bit 4: wavefront rows
+ *                                bit 5: planar slices
+ *                                bit 6: states carried over from the previous frame
+ *                                bit 7: a Predictor signalled per row
+ *     u8  channels               1..4
+ *     u8  bit_depth              8
+ *     u8  model                  bits 0-3: context model, see Model
+ *                                bits 4-7: InitialStates of the range coders
+ *     u32 width
+ *     u32 height
+ *     u16 slice_cols
+ *     u16 slice_rows
+ *     u32 metadata size, followed by that many opaque bytes
+ *     u64 slice offset * slice_cols * slice_rows   (index flag only)
+ *     u32 wavefront sync                           (wavefront flag only)
+ *     u32 row size * height                        (wavefront flag only)
+ *     u64 plane size * (channels - 1) * slice_cols * slice_rows   (planar flag only)
+ *     u32 state table size, followed by the table of packStates()  (custom states only)
+ *
+ * Slices follow in raster order of the grid. Offsets are relative to the end of the
+ * header; a slice ends where the next one starts and the last one at the end of the
+ * stream. Without an index the stream holds a single slice.
+ *
+ * A wavefront stream is a single slice whose rows are separate substreams, laid out one
+ * after the other with the sizes given in the header. Row y starts from the states row
+ * y - 1 had after its first `sync` pixels, so once that row is `sync` pixels ahead, row
+ * y can be decoded alongside it.
+ *
+ * A planar slice holds one substream per channel after the colour transform, each with
+ * its own coder and states, so the channels can be coded on separate threads. The planes
+ * follow each other in channel order; the header gives the size of all but the last one
+ * of every slice. Planar and wavefront streams exclude each other.
+ *
+ * A frame of a SequenceEncoder sets bit 6 unless it is a keyframe: each of its slices
+ * (each plane of a planar slice) starts from the states the same slice had at the end of
+ * the previous frame, so it only decodes after that frame. Such frames have no wavefront
+ * rows.
+ *
+ * With bit 7, every row but the first of a slice or plane starts with the Predictor its
+ * samples use, coded by the slice coder itself; other streams predict with MED.
+ *
+ * The residual states of every slice, plane or wavefront image start from the table the
+ * InitialStates select. A custom table has getStatesNb() states for the model and depth.
+ *
+ * Revision 2 is a magic byte, u8 channels, u16 width and u16 height followed by a single
+ * slice coded with the Large model; it is still read.
+ */
+struct Header {
+    enum Flags : uint8_t {
+        HasIndex = 1,
+        WideCoder = 2,
+        GolombRiceCoder = 4,
+        RunMode = 8,
+        Wavefront = 16,
+        Planar = 32,
+        CarriedStates = 64,
+        AdaptivePredictor = 128,
+    };
+
+    uint8_t version = revision;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t channels = 0;
+    uint8_t bit_depth = 8; // 9..16 for uint16_t samples
+    Model model = Model::Large;
+    Coder coder = Coder::Range;
+    bool run_mode = false;
+    uint16_t slice_cols = 1;
+    uint16_t slice_rows = 1;
+    std::vector<uint64_t> index;
+    std::vector<uint8_t> metadata;
+    uint32_t wavefront_sync = 0; // 0 = rows are not separate substreams
+    std::vector<uint32_t> row_sizes; // coded size of every row of a wavefront stream
+    bool planar = false;
+    std::vector<uint64_t> plane_sizes; // channels - 1 per slice in a planar stream
+    bool carried_states = false; // slices continue from the previous frame of a sequence
+    bool adaptive_predictor = false; // every row past the first of a slice or plane codes its Predictor
+    InitialStates initial_states = InitialStates::Default;
+    std::vector<uint8_t> custom_states; // table of InitialStates::Custom, in the order of ContextStates::bins
+    std::vector<uint8_t> packed_states; // custom_states as packStates() stores them
+
+    int substates() const { return bit_depth > 8 ? deep_substates_nb : substates_nb; }
+
+    size_t slices() const { return size_t(slice_cols) * slice_rows; }
+
+    Rect slice(size_t i) const {
+        return sliceRect(width, height, slice_cols, slice_rows, i % slice_cols, i / slice_cols);
+    }
+
+    /// Serialized size in bytes.
+    size_t size() const {
+        if (version == 2) return 6;
+        return 21 + metadata.size() + (index.empty() ? 0 : 8 * slices()) + (wavefront_sync ? 4 + 4 * size_t(height) : 0) +
+               8 * plane_sizes.size() + (initial_states == InitialStates::Custom ? 4 + packed_states.size() : 0);
+    }
+
+    template <typename PutByte>
+    void write(PutByte&& put) const {
+        auto putLE = [&](uint64_t x, int bytes) {
+            for (int i = 0; i < bytes; ++i) put(uint8_t(x >> (8 * i)));
+        };
+        putLE(magic_revision, 1);
+        putLE((index.empty() ? 0 : HasIndex) | (coder == Coder::WideRange ? WideCoder : 0) |
+              (coder == Coder::GolombRice ? GolombRiceCoder : 0) | (run_mode ? RunMode : 0) |
+              (wavefront_sync ? Wavefront : 0) | (planar ? Planar : 0) | (carried_states ? CarriedStates : 0) |
+              (adaptive_predictor ? AdaptivePredictor : 0), 1);
+        putLE(channels, 1);
+        putLE(bit_depth, 1);
+        putLE(uint8_t(model) | uint8_t(initial_states) << 4, 1);
+        putLE(width, 4);
+        putLE(height, 4);
+        putLE(slice_cols, 2);
+        putLE(slice_rows, 2);
+        putLE(metadata.size(), 4);
+        for (uint8_t x : metadata) put(x);
+        for (uint64_t offset : index) putLE(offset, 8);
+        if (wavefront_sync) {
+            putLE(wavefront_sync, 4);
+            for (uint32_t size : row_sizes) putLE(size, 4);
+        }
+        for (uint64_t size : plane_sizes) putLE(size, 8);
+        if (initial_states == InitialStates::Custom) {
+            putLE(packed_states.size(), 4);
+            for (uint8_t x : packed_states) put(x);
+        }
+    }
+
+    /**
+     * @brief Parses and validates a header.
+     * @param get Callable `uint8_t()` returning the next byte; it throws on a short stream.
+     */
+    template <typename GetByte>
+    static Header read(GetByte&& get) {
+        Header h;
+        h.parse(get);
+        return h;
+    }
+
+    /**
+     * @brief Same as read(), but parses into this header and reuses its buffers.
+     */
+    template <typename GetByte>
+    void parse(GetByte&& get) {
+        auto getLE = [&](int bytes) {
+            uint64_t x = 0;
+            for (int i = 0; i < bytes; ++i) x |= uint64_t(get()) << (8 * i);
+            return x;
+        };
+        Header& h = *this;
+        h.version = revision;
+        h.bit_depth = 8;
+        h.model = Model::Large;
+        h.coder = Coder::Range;
+        h.run_mode = false;
+        h.slice_cols = 1;
+        h.slice_rows = 1;
+        h.index.clear();
+        h.metadata.clear();
+        h.wavefront_sync = 0;
+        h.row_sizes.clear();
+        h.planar = false;
+        h.plane_sizes.clear();
+        h.carried_states = false;
+        h.adaptive_predictor = false;
+        h.initial_states = InitialStates::Default;
+        h.custom_states.clear();
+        h.packed_states.clear();
+        const uint8_t magic = get();
+        if (magic == magic_revision_v2) {
+            h.version = 2;
+            h.channels = get();
+            h.width = getLE(2);
+            h.height = getLE(2);
+        } else if (magic == magic_revision) {
+            const uint8_t flags = get();
+            if ((flags & ~(HasIndex | WideCoder | GolombRiceCoder | RunMode | Wavefront | Planar | CarriedStates | AdaptivePredictor)) ||
+                (flags & WideCoder && flags & GolombRiceCoder) || (flags & Wavefront && flags & (Planar | CarriedStates))) {
+                throw std::runtime_error("Unsupported stream flags");
+            }
+            h.coder = flags & WideCoder ? Coder::WideRange : flags & GolombRiceCoder ? Coder::GolombRice : Coder::Range;
+            h.run_mode = flags & RunMode;
+            h.carried_states = flags & CarriedStates;
+            h.adaptive_predictor = flags & AdaptivePredictor;
+            h.channels = get();
+            h.bit_depth = get();
+            const uint8_t model = get();
+            if ((model & 15) >= models_nb) {
+                throw std::runtime_error("Unsupported context model");
+            }
+            h.model = Model(model & 15);
+            if ((model >> 4) > uint8_t(InitialStates::Custom) || (model >> 4 && h.coder == Coder::GolombRice)) {
+                throw std::runtime_error("Unsupported initial states");
+            }
+            h.initial_states = InitialStates(model >> 4);
+            h.width = getLE(4);
+            h.height = getLE(4);
+            h.slice_cols = getLE(2);
+            h.slice_rows = getLE(2);
+            const uint32_t metadata_size = getLE(4);
+            for (uint32_t i = 0; i < metadata_size; ++i) h.metadata.push_back(get());
+            if (flags & HasIndex) {
+                for (size_t i = 0; i < h.slices(); ++i) h.index.push_back(getLE(8));
+            }
+            if (flags & Wavefront) {
+                h.wavefront_sync = getLE(4);
+                if (h.wavefront_sync == 0 || h.slices() > 1) {
+                    throw std::runtime_error("Invalid wavefront rows");
+                }
+                for (uint32_t y = 0; y < h.height; ++y) h.row_sizes.push_back(getLE(4));
+            }
+            h.planar = flags & Planar;
+            if (h.planar && h.channels >= 1 && h.channels <= 4) {
+                for (size_t i = 0; i < h.slices() * (h.channels - 1); ++i) h.plane_sizes.push_back(getLE(8));
+            }
+            if (h.initial_states == InitialStates::Custom) {
+                const uint32_t packed_size = getLE(4);
+                const size_t count = getStatesNb(h.model, h.bit_depth);
+                if (packed_size > count) {
+                    throw std::runtime_error("Invalid initial states");
+                }
+                h.packed_states.resize(packed_size);
+                for (auto& x : h.packed_states) x = get();
+                unpackStates(h.packed_states, count, h.substates(), h.custom_states);
+            }
+        } else {
+            throw std::runtime_error("Invalid magic number");
+        }
+        // rows above 8 bits are not shared between wavefront decoders
+        if (h.channels < 1 || h.channels > 4 || h.bit_depth < 8 || h.bit_depth > 16 || (h.bit_depth > 8 && h.wavefront_sync)) {
+            throw std::runtime_error("Unsupported sample format");
+        }
+        if (h.initial_states == InitialStates::Trained && !trainedStates(h.model, h.bit_depth)) {
+            throw std::runtime_error("Unsupported initial states");
+        }
+        if (h.width > 0x7FFFFFFF || h.height > 0x7FFFFFFF || uint64_t(h.width) * h.channels > 0x7FFFFFFF) {
+            throw std::runtime_error("Invalid image dimensions");
+        }
+        if (h.slice_cols == 0 || h.slice_rows == 0 || h.slice_cols > std::max<uint32_t>(h.width, 1) ||
+            h.slice_rows > std::max<uint32_t>(h.height, 1) || (h.index.empty() && h.slices() > 1)) {
+            throw std::runtime_error("Invalid slice grid");
+        }
+        for (size_t i = 0; i < h.index.size(); ++i) {
+            if (h.index[i] < (i ? h.index[i - 1] : 0) || (i == 0 && h.index[0] != 0)) {
+                throw std::runtime_error("Invalid slice index");
+            }
+        }
+    }
+};
+
+/**
+ * @brief Byte source for the range decoders reading from a window of memory.
+ *
+ * When the window is exhausted and `stream` is set, the streaming Decoder hands out the
+ * next window; otherwise zeros are returned past the end, as the coder expects.
+ */
+class Decoder;
+struct ByteReader {
+    const uint8_t* cur = nullptr;
+    const uint8_t* end = nullptr;
+    Decoder* stream = nullptr;
+
+    inline uint8_t operator()();
+
+    /// Next two bytes, big endian, for WideRangeDecoder.
+    uint32_t read16() {
+        if (end - cur >= 2) {
+            const uint32_t word = uint32_t(cur[0]) << 8 | cur[1];
+            cur += 2;
+            return word;
+        }
+        const uint32_t hi = (*this)();
+        return hi << 8 | (*this)();
+    }
+};
+
+/**
+ * @brief Ring of lines with replicated borders, three unless rows are decoded concurrently.
+ *
+ * Every line has two pixels of padding on the left and one on the right. The kernels keep
+ * them equal to what the edge rules of the codec would substitute, so interior and border
+ * pixels read their neighbours the same way:
+ *  - before pixel 0 both left pads hold the value predicted for it (half the sample range
+ *    on the first row, 128 for 8 bits; the sample above otherwise);
+ *  - after pixel 0 the nearest left pad takes its value (left of pixel 1 is pixel 0);
+ *  - after the last pixel the right pad takes its value.
+ * On the second row the line two above is the line above, so `T` falls back to `t`.
+ *
+ * After the RCT, 8-bit samples fit `int16_t`; deeper ones need `int32_t` lines.
+ */
+template <typename T>
+struct BasicLineRing {
+    static constexpr int pad_left = 2;
+    static constexpr int pad_right = 1;
+
+    BasicLineRing(int width, int channels, int count = 3) : lines(count) {
+        reset(width, channels);
+    }
+
+    /// Resizes the lines for a new slice, reusing their storage.
+    void reset(int width, int channels) {
+        this->channels = channels;
+        for (auto& line : lines) {
+            line.resize(size_t(width + pad_left + pad_right) * channels);
+        }
+    }
+
+    /// Line of row `h`, which may be as low as `-count`.
+    T* line(int h) {
+        const int count = int(lines.size());
+        return lines[(h + count) % count].data() + pad_left * channels;
+    }
+
+    int channels;
+    std::vector<std::vector<T>> lines;
+};
+
+using LineRing = BasicLineRing<int16_t>;
+
+/**
+ * @brief Line sample type of the row kernels coding `Sample`: uint8_t pixels and the
+ *        int16_t planes transformed from them go to `int16_t` lines, uint16_t pixels and
+ *        their int32_t planes to `int32_t` lines.
+ */
+template <typename Sample>
+using LineSample = std::conditional_t<std::is_same_v<Sample, uint16_t> || std::is_same_v<Sample, int32_t>, int32_t, int16_t>;
+
+/**
+ * @brief Gradient between samples of 8 + `shift` bits brought to the 8-bit scale of the
+ *        quantizers, rounding towards zero.
+ *
+ * The thresholds of quant11 and quant5 thereby scale with the sample range, as in JPEG-LS,
+ * and the context count stays the same at every depth.
+ */
+inline int scaleGradient(int d, int shift) {
+    return d < 0 ? -(-d >> shift) : d >> shift;
+}
+
+/**
+ * @brief Part of the context hash taken from the rows above.
+ * @param shift Bit depth above 8, see scaleGradient().
+ */
+template <Model M>
+inline int topHash(int t, int tl, int tr, int T, int shift = 0) {
+    if constexpr (M == Model::Tiny) {
+        return quant5(scaleGradient(tl - t, shift)) * 5 + quant5(scaleGradient(t - tr, shift)) * (5 * 5);
+    }
+    int hash = quant11(scaleGradient(tl - t, shift)) * (11) + quant11(scaleGradient(t - tr, shift)) * (11 * 11);
+    if constexpr (M == Model::Large) {
+        hash += quant5(scaleGradient(T - t, shift)) * (5 * 5 * 11 * 11);
+    }
+    return hash;
+}
+
+/**
+ * @brief Part of the context hash taken from the current row.
+ */
+template <Model M>
+inline int leftHash(int l, int L, int tl, int shift = 0) {
+    if constexpr (M == Model::Tiny) {
+        return quant5(scaleGradient(l - tl, shift));
+    }
+    int hash = quant11(scaleGradient(l - tl, shift));
+    if constexpr (M == Model::Large) {
+        hash += quant5(scaleGradient(L - l, shift)) * (5 * 11 * 11);
+    }
+    return hash;
+}
+
+/**
+ * @brief Prediction `P` of a sample from its left, left-of-left, top, top-left, top-right,
+ *        top-of-top and top-right-of-top neighbours.
+ *
+ * Like MED, every prediction stays between neighbours of the sample, so residuals keep the
+ * range the binarization and the coded size bounds assume.
+ */
+template <Predictor P>
+inline int predictFrom(int l, int L, int t, int tl, int tr, int T, int Tr, int shift = 0) {
+    if constexpr (P == Predictor::Med) {
+        return median(l, l + t - tl, t);
+    } else if constexpr (P == Predictor::Left) {
+        return l;
+    } else if constexpr (P == Predictor::Top) {
+        return t;
+    } else if constexpr (P == Predictor::Average) {
+        return (l + t) >> 1;
+    } else {
+        // CALIC's thresholds, on gradients scaled like the context hash
+        const int dh = std::abs(l - L) + std::abs(t - tl) + std::abs(t - tr);
+        const int dv = std::abs(l - tl) + std::abs(t - T) + std::abs(tr - Tr);
+        const int d = (dv - dh) >> shift;
+        if (d > 80) return l;
+        if (d < -80) return t;
+        int p = ((l + t) >> 1) + ((tr - tl) >> 2);
+        if (d > 32) p = (p + l) >> 1;
+        else if (d > 8) p = (3 * p + l) >> 2;
+        else if (d < -32) p = (p + t) >> 1;
+        else if (d < -8) p = (3 * p + t) >> 2;
+        return std::clamp(p, std::min({l, t, tr}), std::max({l, t, tr}));
+    }
+}
+
+/**
+ * @brief Context hash and prediction of one sample.
+ *
+ * @param cur Current sample in the padded current line.
+ * @param top Same sample in the line above (unused on the first row).
+ * @param top2 Same sample two lines above.
+ * @param shift Bit depth above 8.
+ */
+template <Model M, int C, bool FirstRow, Predictor P = Predictor::Med, typename Line>
+inline void predictSample(const Line* cur, const Line* top, const Line* top2, int& hash, int& predict, int shift = 0) {
+    const int l = cur[-C];
+    const int L = cur[-2 * C];
+    const int t = FirstRow ? l : top[0];
+    const int tl = FirstRow ? l : top[-C];
+    const int tr = FirstRow ? l : top[C];
+    const int T = FirstRow ? l : top2[0];
+
+    hash = leftHash<M>(l, L, tl, shift) + topHash<M>(t, tl, tr, T, shift);
+    if constexpr (P == Predictor::Gradient && !FirstRow) {
+        predict = predictFrom<P>(l, L, t, tl, tr, T, top2[C], shift);
+    } else {
+        predict = predictFrom<FirstRow ? Predictor::Med : P>(l, L, t, tl, tr, T, T, shift);
+    }
+}
+
+/**
+ * @brief Row-wise context modelling that does not depend on the entropy coder.
+ *
+ * All inputs of the context hash and of the MED prediction are known once a row has been
+ * colour transformed on the encoder side, so a whole row is modelled up front and the
+ * coder loop only walks the resulting arrays. On the decoder, the part of the hash taken
+ * from the rows above is computed up front in the same way.
+ *
+ * quant11/quant5 are symmetric step functions (thresholds 1, 2, 5, 12, 35 and 1, 4), so the
+ * SIMD versions count compares instead of looking up the tables. An AVX2 or SSE4.1 kernel is
+ * picked at runtime, with a scalar fallback; all of them are bit-exact.
+ */
+namespace rowmodel {
+    /**
+     * @brief Context and residual of `n` samples of a row that is not the first one.
+     *
+     * @param cur First sample in the padded current line; `cur[-C]` and `cur[-2 * C]` must
+     *            already hold the left neighbours.
+     * @param ctx Receives |hash|.
+     * @param res Receives the residual, negated where the hash was negative.
+     */
+    using ContextFn = void (*)(const int16_t* cur, const int16_t* top, const int16_t* top2, int C, int n, int16_t* ctx, int16_t* res);
+    /**
+     * @brief Part of the hash that only depends on the rows above, for `n` samples.
+     */
+    using TopContextFn = void (*)(const int16_t* top, const int16_t* top2, int C, int n, int16_t* out);
+
+    template <Model M>
+    inline void contextScalar(const int16_t* cur, const int16_t* top, const int16_t* top2, int C, int n, int16_t* ctx, int16_t* res) {
+        for (int j = 0; j < n; ++j) {
+            const int l = cur[j - C];
+            const int L = cur[j - 2 * C];
+            const int t = top[j];
+            const int tl = top[j - C];
+            const int tr = top[j + C];
+            const int T = top2[j];
+            const int hash = leftHash<M>(l, L, tl) + topHash<M>(t, tl, tr, T);
+            const int diff = cur[j] - median(l, l + t - tl, t);
+            ctx[j] = hash < 0 ? -hash : hash;
+            res[j] = hash < 0 ? -diff : diff;
+        }
+    }
+
+    template <Model M>
+    inline void topContextScalar(const int16_t* top, const int16_t* top2, int C, int n, int16_t* out) {
+        for (int j = 0; j < n; ++j) {
+            out[j] = topHash<M>(top[j], top[j - C], top[j + C], top2[j]);
+        }
+    }
+
+#ifdef LLCOMP_X86_SIMD
+    // One implementation for both widths: V is the register type, the lambdas wrap intrinsics.
+    #define LLCOMP_ROWMODEL_KERNELS(TARGET, V, W, LOAD, STORE, SET1, ADD, SUB, MULLO, CMPGT, ABS, SIGN, MIN, MAX, XOR) \
+    __attribute__((target(TARGET))) inline V quant11_##W(V x) { \
+        const V a = ABS(x); \
+        V neg = ADD(ADD(CMPGT(a, SET1(0)), CMPGT(a, SET1(1))), ADD(CMPGT(a, SET1(4)), CMPGT(a, SET1(11)))); \
+        neg = ADD(neg, CMPGT(a, SET1(34))); \
+        return SIGN(SUB(SET1(0), neg), x); \
+    } \
+    __attribute__((target(TARGET))) inline V quant5_##W(V x) { \
+        const V a = ABS(x); \
+        const V neg = ADD(CMPGT(a, SET1(0)), CMPGT(a, SET1(3))); \
+        return SIGN(SUB(SET1(0), neg), x); \
+    } \
+    template <Model M> \
+    __attribute__((target(TARGET))) inline V topHash_##W(V t, V tl, V tr, V T) { \
+        if constexpr (M == Model::Tiny) { \
+            return ADD(MULLO(quant5_##W(SUB(tl, t)), SET1(5)), MULLO(quant5_##W(SUB(t, tr)), SET1(5 * 5))); \
+        } \
+        V hash = ADD(MULLO(quant11_##W(SUB(tl, t)), SET1(11)), MULLO(quant11_##W(SUB(t, tr)), SET1(11 * 11))); \
+        if constexpr (M == Model::Large) hash = ADD(hash, MULLO(quant5_##W(SUB(T, t)), SET1(5 * 5 * 11 * 11))); \
+        return hash; \
+    } \
+    template <Model M> \
+    __attribute__((target(TARGET))) inline V leftHash_##W(V l, V L, V tl) { \
+        if constexpr (M == Model::Tiny) return quant5_##W(SUB(l, tl)); \
+        V hash = quant11_##W(SUB(l, tl)); \
+        if constexpr (M == Model::Large) hash = ADD(hash, MULLO(quant5_##W(SUB(L, l)), SET1(5 * 11 * 11))); \
+        return hash; \
+    } \
+    template <Model M> \
+    __attribute__((target(TARGET))) inline void context_##W(const int16_t* cur, const int16_t* top, const int16_t* top2, int C, int n, int16_t* ctx, int16_t* res) { \
+        constexpr int lanes = sizeof(V) / sizeof(int16_t); \
+        int j = 0; \
+        for (; j + lanes <= n; j += lanes) { \
+            const V l = LOAD(cur + j - C); \
+            const V L = LOAD(cur + j - 2 * C); \
+            const V t = LOAD(top + j); \
+            const V tl = LOAD(top + j - C); \
+            const V tr = LOAD(top + j + C); \
+            const V T = LOAD(top2 + j); \
+            const V hash = ADD(leftHash_##W<M>(l, L, tl), topHash_##W<M>(t, tl, tr, T)); \
+            const V predict = MAX(MIN(l, t), MIN(MAX(l, t), SUB(ADD(l, t), tl))); \
+            const V diff = SUB(LOAD(cur + j), predict); \
+            const V negative = CMPGT(SET1(0), hash); \
+            STORE(ctx + j, ABS(hash)); \
+            STORE(res + j, SUB(XOR(diff, negative), negative)); \
+        } \
+        contextScalar<M>(cur + j, top + j, top2 + j, C, n - j, ctx + j, res + j); \
+    } \
+    template <Model M> \
+    __attribute__((target(TARGET))) inline void topContext_##W(const int16_t* top, const int16_t* top2, int C, int n, int16_t* out) { \
+        constexpr int lanes = sizeof(V) / sizeof(int16_t); \
+        int j = 0; \
+        for (; j + lanes <= n; j += lanes) { \
+            STORE(out + j, topHash_##W<M>(LOAD(top + j), LOAD(top + j - C), LOAD(top + j + C), LOAD(top2 + j))); \
+        } \
+        topContextScalar<M>(top + j, top2 + j, C, n - j, out + j); \
+    }
+
+    #define LLCOMP_SSE_LOAD(p) _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))
+    #define LLCOMP_SSE_STORE(p, v) _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v)
+    LLCOMP_ROWMODEL_KERNELS("sse4.1", __m128i, sse41, LLCOMP_SSE_LOAD, LLCOMP_SSE_STORE, _mm_set1_epi16, _mm_add_epi16,
+                            _mm_sub_epi16, _mm_mullo_epi16, _mm_cmpgt_epi16, _mm_abs_epi16, _mm_sign_epi16,
+                            _mm_min_epi16, _mm_max_epi16, _mm_xor_si128)
+    #define LLCOMP_AVX_LOAD(p) _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))
+    #define LLCOMP_AVX_STORE(p, v) _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v)
+    LLCOMP_ROWMODEL_KERNELS("avx2", __m256i, avx2, LLCOMP_AVX_LOAD, LLCOMP_AVX_STORE, _mm256_set1_epi16, _mm256_add_epi16,
+                            _mm256_sub_epi16, _mm256_mullo_epi16, _mm256_cmpgt_epi16, _mm256_abs_epi16, _mm256_sign_epi16,
+                            _mm256_min_epi16, _mm256_max_epi16, _mm256_xor_si256)
+    #undef LLCOMP_SSE_LOAD
+    #undef LLCOMP_SSE_STORE
+    #undef LLCOMP_AVX_LOAD
+    #undef LLCOMP_AVX_STORE
+    #undef LLCOMP_ROWMODEL_KERNELS
+#endif
+
+    /// Kernels of one instruction set, indexed by Model.
+    struct Kernels {
+        ContextFn context[models_nb];
+        TopContextFn top_context[models_nb];
+        const char* name;
+    };
+
+    #define LLCOMP_ROWMODEL_SET(W, NAME) Kernels{ \
+        {context##W<Model::Tiny>, context##W<Model::Small>, context##W<Model::Large>}, \
+        {topContext##W<Model::Tiny>, topContext##W<Model::Small>, topContext##W<Model::Large>}, NAME}
+
+    /**
+     * @brief Best kernels for the running CPU, detected once.
+     */
+    inline const Kernels& kernels() {
+        static const Kernels best = [] {
+#ifdef LLCOMP_X86_SIMD
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2")) return LLCOMP_ROWMODEL_SET(_avx2, "avx2");
+            if (__builtin_cpu_supports("sse4.1")) return LLCOMP_ROWMODEL_SET(_sse41, "sse4.1");
+#endif
+            return LLCOMP_ROWMODEL_SET(Scalar, "scalar");
+        }();
+        return best;
+    }
+    #undef LLCOMP_ROWMODEL_SET
+}
+
+/**
+ * @brief Output stage of the decoder: colour-transformed lines to 8-bit samples.
+ *
+ * The row kernels only reconstruct the transformed samples the prediction needs; undoing
+ * the RCT, clamping and storing is a separate pass over the finished line, off the serial
+ * entropy loop. The SIMD version computes the green of every lane and of both its
+ * neighbours, then keeps what the channel of the lane needs, so interleaved samples need
+ * no shuffles. packus clamps to 0..255 like the scalar code.
+ */
+namespace rowoutput {
+    /// Writes the `n` interleaved samples of `line`, a whole number of pixels, to `out`.
+    using InterleavedFn = void (*)(const int16_t* line, int C, int n, uint8_t* out);
+
+    inline void interleavedScalar(const int16_t* line, int C, int n, uint8_t* out) {
+        if (C < 3) {
+            for (int j = 0; j < n; ++j) out[j] = uint8_t(line[j]);
+            return;
+        }
+        for (int x = 0; x < n; x += C) {
+            int r = line[x + 0];
+            int g = line[x + 1];
+            int b = line[x + 2];
+            g -= ((r + b) / 4);
+            r += g;
+            b += g;
+            out[x + 0] = std::max(0, std::min(255, r));
+            out[x + 1] = std::max(0, std::min(255, g));
+            out[x + 2] = std::max(0, std::min(255, b));
+            for (int i = 3; i < C; ++i) out[x + i] = uint8_t(line[x + i]);
+        }
+    }
+
+#ifdef LLCOMP_X86_SIMD
+    /// (r + b) / 4 rounded towards zero, as in the scalar code.
+    __attribute__((target("sse4.1"))) inline __m128i quarter_sse41(__m128i x) {
+        return _mm_srai_epi16(_mm_add_epi16(x, _mm_and_si128(_mm_srai_epi16(x, 15), _mm_set1_epi16(3))), 2);
+    }
+
+    /// Reads the two samples before the line, which its left padding holds.
+    __attribute__((target("sse4.1"))) inline void interleaved_sse41(const int16_t* line, int C, int n, uint8_t* out) {
+        int j = 0;
+        if (C < 3) {
+            for (; j + 16 <= n; j += 16) {
+                const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + j));
+                const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + j + 8));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + j), _mm_packus_epi16(lo, hi));
+            }
+        } else {
+            // a block is a whole number of pixels and of vectors; lane masks by channel
+            const int block = C == 3 ? 24 : 8;
+            __m128i red[3], green[3], blue[3];
+            for (int v = 0; v < block / 8; ++v) {
+                alignas(16) int16_t r[8], g[8], b[8];
+                for (int k = 0; k < 8; ++k) {
+                    const int channel = (v * 8 + k) % C;
+                    r[k] = channel == 0 ? -1 : 0;
+                    g[k] = channel == 1 ? -1 : 0;
+                    b[k] = channel == 2 ? -1 : 0;
+                }
+                red[v] = _mm_load_si128(reinterpret_cast<const __m128i*>(r));
+                green[v] = _mm_load_si128(reinterpret_cast<const __m128i*>(g));
+                blue[v] = _mm_load_si128(reinterpret_cast<const __m128i*>(b));
+            }
+            for (; j + block + 2 <= n; j += block) {
+                for (int v = 0; v < block / 8; ++v) {
+                    const int16_t* p = line + j + v * 8;
+                    const __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                    const __m128i l1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p - 1));
+                    const __m128i l2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p - 2));
+                    const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+                    const __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2));
+                    // green of the lane, of the lane after it (red) and of the lane before it (blue)
+                    const __m128i g = _mm_sub_epi16(s0, quarter_sse41(_mm_add_epi16(l1, r1)));
+                    const __m128i g_next = _mm_sub_epi16(r1, quarter_sse41(_mm_add_epi16(s0, r2)));
+                    const __m128i g_prev = _mm_sub_epi16(l1, quarter_sse41(_mm_add_epi16(l2, s0)));
+                    __m128i x = _mm_blendv_epi8(s0, _mm_add_epi16(s0, g_next), red[v]);
+                    x = _mm_blendv_epi8(x, g, green[v]);
+                    x = _mm_blendv_epi8(x, _mm_add_epi16(s0, g_prev), blue[v]);
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + j + v * 8), _mm_packus_epi16(x, x));
+                }
+            }
+        }
+        interleavedScalar(line + j, C, n - j, out + j);
+    }
+#endif
+
+    /**
+     * @brief Best interleaved kernel for the running CPU, detected once.
+     */
+    inline InterleavedFn interleaved() {
+        static const InterleavedFn best = [] {
+#ifdef LLCOMP_X86_SIMD
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("sse4.1")) return &interleaved_sse41;
+#endif
+            return &interleavedScalar;
+        }();
+        return best;
+    }
+}
+
+/**
+ * @brief Writes a decoded line of `width` pixels to `out`, interleaved or, with a
+ *        `plane_stride`, one plane per channel.
+ */
+inline void outputRow(const int16_t* line, int width, int channels, uint8_t* out, size_t plane_stride) {
+    if (plane_stride == 0) {
+        rowoutput::interleaved()(line, channels, width * channels, out);
+        return;
+    }
+    for (int w = 0; w < width; ++w) {
+        const int16_t* px = line + w * channels;
+        int i = 0;
+        if (channels >= 3) {
+            int r = px[0];
+            int g = px[1];
+            int b = px[2];
+            g -= ((r + b) / 4);
+            r += g;
+            b += g;
+            out[w] = std::max(0, std::min(255, r));
+            out[plane_stride + w] = std::max(0, std::min(255, g));
+            out[2 * plane_stride + w] = std::max(0, std::min(255, b));
+            i = 3;
+        }
+        for (; i < channels; ++i) out[i * plane_stride + w] = uint8_t(px[i]);
+    }
+}
+
+/**
+ * @brief outputRow() for samples above 8 bits, clamped to `maxval`; `plane_stride` counts
+ *        samples.
+ */
+inline void outputRow(const int32_t* line, int width, int channels, uint16_t* out, size_t plane_stride, int maxval) {
+    const size_t step = plane_stride ? 1 : channels;
+    const size_t next = plane_stride ? plane_stride : 1;
+    for (int w = 0; w < width; ++w) {
+        const int32_t* px = line + w * channels;
+        uint16_t* sample = out + w * step;
+        int i = 0;
+        if (channels >= 3) {
+            int r = px[0];
+            int g = px[1];
+            int b = px[2];
+            g -= ((r + b) / 4);
+            r += g;
+            b += g;
+            sample[0] = std::max(0, std::min(maxval, r));
+            sample[next] = std::max(0, std::min(maxval, g));
+            sample[2 * next] = std::max(0, std::min(maxval, b));
+            i = 3;
+        }
+        for (; i < channels; ++i) sample[i * next] = uint16_t(px[i]);
+    }
+}
+
+/**
+ * @brief Picks a row kernel for the coder, context model and channel count of a header.
+ *
+ * `pick` is called with the three as `std::integral_constant` values and returns the
+ * matching kernel instantiation.
+ */
+template <typename Pick>
+inline auto pickRowKernel(const Header& header, Pick&& pick) {
+    auto channels = [&](auto coder, auto model) {
+        switch (header.channels) {
+            case 1: return pick(coder, model, std::integral_constant<int, 1>{});
+            case 2: return pick(coder, model, std::integral_constant<int, 2>{});
+            case 3: return pick(coder, model, std::integral_constant<int, 3>{});
+            case 4: return pick(coder, model, std::integral_constant<int, 4>{});
+            default: throw std::invalid_argument("Unsupported channel count");
+        }
+    };
+    auto model = [&](auto coder) {
+        switch (header.model) {
+            case Model::Tiny: return channels(coder, std::integral_constant<Model, Model::Tiny>{});
+            case Model::Small: return channels(coder, std::integral_constant<Model, Model::Small>{});
+            case Model::Large: return channels(coder, std::integral_constant<Model, Model::Large>{});
+            default: throw std::invalid_argument("Unsupported context model");
+        }
+    };
+    switch (header.coder) {
+        case Coder::Range: return model(std::integral_constant<Coder, Coder::Range>{});
+        case Coder::WideRange: return model(std::integral_constant<Coder, Coder::WideRange>{});
+        case Coder::GolombRice: return model(std::integral_constant<Coder, Coder::GolombRice>{});
+        default: throw std::invalid_argument("Unsupported coder");
+    }
+}
+
+/**
+ * @brief JPEG-LS style run mode.
+ *
+ * When every sample of a pixel has context hash 0, its neighbourhood is flat and the
+ * coder switches to a run of copies of the left pixel. A run is cut into chunks of
+ * 2^run_order[index] pixels, each signalled by a 1 bit, the index growing after every
+ * full chunk. A 0 bit and run_order[index] bits of remainder end the run before the end
+ * of the row and shrink the index. A run reaching the end of the row needs no terminator.
+ */
+constexpr inline int run_contexts_nb = 32;
+constexpr inline std::array<int, run_contexts_nb> run_order = {
+    0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+};
+
+template <int C, typename T>
+inline bool flatContext(const T* hash) {
+    for (int i = 0; i < C; ++i) {
+        if (hash[i] != 0) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Signalling of the row predictors of a stream with adaptive predictors.
+ *
+ * A row keeping the Predictor of the row before it codes a 0. Otherwise it codes a 1,
+ * then the index of its predictor among the four others in two bits, the second bit with
+ * a state per value of the first. Golomb-Rice slices write the same bits raw.
+ */
+constexpr inline int predictor_states_nb = 4;
+
+constexpr inline int predictor_stride = 4; // pixels between the samples SliceEncoder::pickPredictor() inspects
+
+/**
+ * @brief Adaptive states of a slice coder, which a wavefront row inherits from the row above.
+ */
+struct ContextStates {
+    std::vector<cabac::State> bins;
+    std::vector<golomb::State> golomb;
+    std::array<cabac::State, run_contexts_nb> run;
+    std::array<cabac::State, 16> run_bits; // remainder bit b of a run
+    int run_index = 0;
+    std::array<cabac::State, predictor_states_nb> predictor_bits;
+    Predictor predictor = Predictor::Med; // of the last row
+    int substates = substates_nb; // states of a context in `bins`
+
+    /// Initial states for the coder and model of `header`; only the coder in use gets a table.
+    void reset(const Header& header) {
+        if (header.coder == Coder::GolombRice) {
+            golomb.assign(getContextsNb(header.model), golomb::State{});
+            bins.clear();
+        } else {
+            bins.resize(getStatesNb(header.model, header.bit_depth));
+            const uint8_t* table = header.initial_states == InitialStates::Trained ? trainedStates(header.model, header.bit_depth)
+                                 : header.initial_states == InitialStates::Custom ? header.custom_states.data() : nullptr;
+            for (size_t i = 0; i < bins.size(); ++i) bins[i].state = table ? table[i] : 0;
+            golomb.clear();
+        }
+        run.fill(cabac::State{});
+        run_bits.fill(cabac::State{});
+        run_index = 0;
+        predictor_bits.fill(cabac::State{});
+        predictor = Predictor::Med;
+        substates = header.bit_depth > 8 ? deep_substates_nb : substates_nb;
+    }
+};
+
+#ifdef LLCOMP_STATS
+constexpr inline bool stats_enabled = true;
+#else
+constexpr inline bool stats_enabled = false;
+#endif
+
+/**
+ * @brief Where the bits and the time of a coded image go, to spot pathological inputs and
+ *        tune the context model.
+ *
+ * The codec only fills it when compiled with LLCOMP_STATS defined; otherwise the hooks
+ * are compiled out and a stats object handed to the API stays empty. The bits of a binary
+ * decision are its information content, -log2(p) under the probability it was coded
+ * with, so the encoder and the decoder of a stream report the same figures; Golomb-Rice
+ * codes count their actual length. Phase and row times are summed over the threads
+ * coding the slices; `wall_ns` is the duration of the calls. A stats object adds up
+ * every call it is handed to, e.g. the frames of a SequenceEncoder.
+ */
+struct CodecStats {
+    /// Parts of a residual code, plus the run mode and the row predictors. The unary prefix
+    /// of a Golomb-Rice code counts as its exponent, its k low bits as its mantissa.
+    enum Stage : int { ZeroFlag, Exponent, Mantissa, Sign, Run, Predictors, stages_nb };
+    /// Modelling, the colour transform and context modelling ahead of the coder, is only a
+    /// phase of its own on the encoder. Output undoes the colour transform of decoded rows.
+    enum Phase : int { Modelling, Coding, Output, phases_nb };
+
+    uint64_t raw_bytes = 0;
+    uint64_t coded_bytes = 0;
+    uint64_t residuals = 0; // samples coded one at a time
+    uint64_t run_pixels = 0; // pixels, or samples of a planar slice, coded as part of a run
+    uint64_t bins = 0; // binary decisions of the range coders
+    std::array<double, stages_nb> stage_bits{};
+    std::array<double, 4> channel_bits{}; // residual bits per channel after the colour transform
+    std::vector<uint64_t> context_hits; // residuals per context, indexed by |hash|
+    std::vector<double> context_bits;
+    std::array<uint64_t, predictors_nb> predictor_rows{}; // rows that signalled each Predictor
+    uint64_t states_adapted = 0; // adaptive states away from their initial value at the end of a slice
+    uint64_t states_total = 0;
+    std::array<uint64_t, phases_nb> phase_ns{};
+    std::vector<uint64_t> row_ns; // time of every image row, summed over the slices crossing it
+    uint64_t wall_ns = 0;
+    /// With `train_window` set, the bits the first `train_window` decisions of every residual
+    /// state of a slice would have taken from each initial state, as [state * 128 + initial],
+    /// and the slices that used the state; see trainStates().
+    int train_window = 0;
+    std::vector<double> opening_bits;
+    std::vector<uint32_t> opening_slices;
+
+    /// Bits of coding `bit` with a range coder probability `p` / 256 of a 1.
+    static double binBits(bool bit, uint8_t p) {
+        static const std::array<double, 257> bits = [] {
+            std::array<double, 257> b{};
+            for (int i = 1; i <= 256; ++i) b[i] = -std::log2(i / 256.0);
+            return b;
+        }();
+        return bits[bit ? p : 256 - p];
+    }
+
+    /**
+     * @brief Decision `sub` of binarization::putSymbol() for a residual of `channel` in
+     *        context `context`, laid out as `Symbol`, a SymbolContexts.
+     */
+    template <typename Symbol>
+    void bin(int context, int channel, int sub, bool bit, uint8_t p) {
+        const double b = binBits(bit, p);
+        ++bins;
+        if (sub == 0) hit(context);
+        const Stage stage = sub == 0 ? ZeroFlag : sub <= Symbol::e_lim ? Exponent : sub == Symbol::s_bit ? Sign : Mantissa;
+        stage_bits[stage] += b;
+        channel_bits[channel] += b;
+        context_bits[context] += b;
+        if (train_window) opening(size_t(context) * Symbol::substates + sub, bit);
+    }
+
+    /// Golomb-Rice code of a residual, split as golomb::codeLength().
+    void golombCode(int context, int channel, std::pair<int, int> length) {
+        hit(context);
+        stage_bits[Exponent] += length.first;
+        stage_bits[Mantissa] += length.second;
+        channel_bits[channel] += length.first + length.second;
+        context_bits[context] += length.first + length.second;
+    }
+
+    /// Bit of a run, coded with probability `p` by the range coders or raw by Golomb-Rice.
+    void runBit(Coder coder, bool bit, uint8_t p) { flagBit(Run, coder, bit, p); }
+
+    void run(int pixels) { run_pixels += pixels; }
+
+    /// Bit signalling the Predictor of a row, coded like a run bit.
+    void predictorBit(Coder coder, bool bit, uint8_t p) { flagBit(Predictors, coder, bit, p); }
+
+    void rowPredictor(Predictor predictor) { ++predictor_rows[int(predictor)]; }
+
+    void phase(Phase phase, uint64_t ns) { phase_ns[phase] += ns; }
+
+    void row(int y, uint64_t ns) {
+        if (size_t(y) >= row_ns.size()) row_ns.resize(y + 1);
+        row_ns[y] += ns;
+    }
+
+    /// Occupancy of the state table of a slice at its end; also sizes the context counts.
+    void countStates(const ContextStates& states) {
+        const size_t contexts = states.golomb.empty() ? states.bins.size() / states.substates : states.golomb.size();
+        if (context_hits.size() < contexts) {
+            context_hits.resize(contexts);
+            context_bits.resize(contexts);
+        }
+        for (const auto& state : states.bins) states_adapted += state.state != 0;
+        for (const auto& state : states.golomb) states_adapted += state.count != 1 || state.error_sum != 4;
+        states_total += states.bins.size() + states.golomb.size();
+        // the next slice opens every state again
+        std::fill(opening_seen.begin(), opening_seen.end(), 0);
+    }
+
+    void merge(const CodecStats& other) {
+        raw_bytes += other.raw_bytes;
+        coded_bytes += other.coded_bytes;
+        residuals += other.residuals;
+        run_pixels += other.run_pixels;
+        bins += other.bins;
+        for (int i = 0; i < stages_nb; ++i) stage_bits[i] += other.stage_bits[i];
+        for (size_t i = 0; i < channel_bits.size(); ++i) channel_bits[i] += other.channel_bits[i];
+        for (int i = 0; i < predictors_nb; ++i) predictor_rows[i] += other.predictor_rows[i];
+        if (context_hits.size() < other.context_hits.size()) {
+            context_hits.resize(other.context_hits.size());
+            context_bits.resize(other.context_bits.size());
+        }
+        for (size_t i = 0; i < other.context_hits.size(); ++i) {
+            context_hits[i] += other.context_hits[i];
+            context_bits[i] += other.context_bits[i];
+        }
+        states_adapted += other.states_adapted;
+        states_total += other.states_total;
+        for (int i = 0; i < phases_nb; ++i) phase_ns[i] += other.phase_ns[i];
+        if (row_ns.size() < other.row_ns.size()) row_ns.resize(other.row_ns.size());
+        for (size_t i = 0; i < other.row_ns.size(); ++i) row_ns[i] += other.row_ns[i];
+        wall_ns += other.wall_ns;
+        if (opening_slices.size() < other.opening_slices.size()) {
+            opening_slices.resize(other.opening_slices.size());
+            opening_bits.resize(other.opening_bits.size());
+        }
+        for (size_t i = 0; i < other.opening_slices.size(); ++i) opening_slices[i] += other.opening_slices[i];
+        for (size_t i = 0; i < other.opening_bits.size(); ++i) opening_bits[i] += other.opening_bits[i];
+    }
+
+    double bits() const {
+        double total = 0;
+        for (double b : stage_bits) total += b;
+        return total;
+    }
+
+    size_t contextsUsed() const {
+        return size_t(std::count_if(context_hits.begin(), context_hits.end(), [](uint64_t n) { return n != 0; }));
+    }
+
+    /// Contexts with 0, 1, 2-3, 4-7... residuals: entry i counts those with [2^(i-1), 2^i).
+    std::vector<uint64_t> hitHistogram() const {
+        std::vector<uint64_t> histogram;
+        for (uint64_t n : context_hits) {
+            const size_t bucket = n ? binarization::ilog2_32(uint32_t(std::min<uint64_t>(n, UINT32_MAX))) + 1 : 0;
+            if (histogram.size() <= bucket) histogram.resize(bucket + 1);
+            ++histogram[bucket];
+        }
+        return histogram;
+    }
+
+    /// Contexts by decreasing bits, at most `n`.
+    std::vector<size_t> costliestContexts(size_t n) const {
+        std::vector<size_t> order(context_bits.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        n = std::min(n, order.size());
+        std::partial_sort(order.begin(), order.begin() + n, order.end(), [&](size_t a, size_t b) {
+            return context_bits[a] > context_bits[b];
+        });
+        order.resize(n);
+        while (!order.empty() && context_hits[order.back()] == 0) order.pop_back();
+        return order;
+    }
+
+    /// Multi-line report for people.
+    std::string text() const {
+        std::string out;
+        char line[512];
+        auto print = [&](auto... args) {
+            std::snprintf(line, sizeof(line), args...);
+            out += line;
+        };
+        const double total = bits();
+        auto share = [&](double b) { return total > 0 ? 100 * b / total : 0.0; };
+        print("%llu bytes raw, %llu coded (ratio %.3f), %.3f bits/sample\n", (unsigned long long)raw_bytes,
+              (unsigned long long)coded_bytes, coded_bytes ? double(raw_bytes) / coded_bytes : 0.0,
+              raw_bytes ? total / raw_bytes : 0.0);
+        print("%llu residuals, %llu run pixels, %llu bins\n", (unsigned long long)residuals, (unsigned long long)run_pixels,
+              (unsigned long long)bins);
+        print("bits by stage: zero %.1f%%, exponent %.1f%%, mantissa %.1f%%, sign %.1f%%, run %.1f%%, predictors %.1f%%\n",
+              share(stage_bits[ZeroFlag]), share(stage_bits[Exponent]), share(stage_bits[Mantissa]), share(stage_bits[Sign]),
+              share(stage_bits[Run]), share(stage_bits[Predictors]));
+        print("bits by channel: %.1f%% %.1f%% %.1f%% %.1f%%\n", share(channel_bits[0]), share(channel_bits[1]), share(channel_bits[2]),
+              share(channel_bits[3]));
+        print("contexts: %zu of %zu used, %llu of %llu states adapted\n", contextsUsed(), context_hits.size(),
+              (unsigned long long)states_adapted, (unsigned long long)states_total);
+        if (std::any_of(predictor_rows.begin(), predictor_rows.end(), [](uint64_t n) { return n != 0; })) {
+            out += "row predictors:";
+            for (int i = 0; i < predictors_nb; ++i) {
+                print("%s %s %llu", i ? "," : "", predictorName(Predictor(i)), (unsigned long long)predictor_rows[i]);
+            }
+            out += "\n";
+        }
+        out += "contexts by residuals:";
+        const auto histogram = hitHistogram();
+        for (size_t i = 0; i < histogram.size(); ++i) {
+            const char* sep = i ? "," : "";
+            if (i < 2) print("%s %zu: %llu", sep, i, (unsigned long long)histogram[i]);
+            else print("%s %llu-%llu: %llu", sep, 1ull << (i - 1), (1ull << i) - 1, (unsigned long long)histogram[i]);
+        }
+        out += "\ncostliest contexts (share of the bits, bits per residual):";
+        const char* sep = "";
+        for (size_t c : costliestContexts(8)) {
+            print("%s %zu (%.1f%%, %.2f)", sep, c, share(context_bits[c]), context_bits[c] / context_hits[c]);
+            sep = ",";
+        }
+        print("\ntime: modelling %.2f ms, coding %.2f ms, output %.2f ms, wall %.2f ms\n", phase_ns[Modelling] / 1e6,
+              phase_ns[Coding] / 1e6, phase_ns[Output] / 1e6, wall_ns / 1e6);
+        if (!row_ns.empty()) {
+            const size_t slowest = size_t(std::max_element(row_ns.begin(), row_ns.end()) - row_ns.begin());
+            uint64_t sum = 0;
+            for (uint64_t ns : row_ns) sum += ns;
+            print("rows: %zu, mean %.1f us, slowest %zu at %.1f us\n", row_ns.size(), sum / 1e3 / row_ns.size(), slowest,
+                  row_ns[slowest] / 1e3);
+        }
+        return out;
+    }
+
+    /// Single-line JSON object; contexts are listed sparsely as [index, residuals, bits].
+    std::string json() const {
+        std::string out;
+        char item[256];
+        auto print = [&](auto... args) {
+            std::snprintf(item, sizeof(item), args...);
+            out += item;
+        };
+        print("{\"raw_bytes\": %llu, \"coded_bytes\": %llu, \"residuals\": %llu, \"run_pixels\": %llu, \"bins\": %llu, \"bits\": %.1f",
+              (unsigned long long)raw_bytes, (unsigned long long)coded_bytes, (unsigned long long)residuals,
+              (unsigned long long)run_pixels, (unsigned long long)bins, bits());
+        print(", \"stage_bits\": {\"zero\": %.1f, \"exponent\": %.1f, \"mantissa\": %.1f, \"sign\": %.1f, \"run\": %.1f, \"predictors\": %.1f}",
+              stage_bits[ZeroFlag], stage_bits[Exponent], stage_bits[Mantissa], stage_bits[Sign], stage_bits[Run], stage_bits[Predictors]);
+        print(", \"channel_bits\": [%.1f, %.1f, %.1f, %.1f]", channel_bits[0], channel_bits[1], channel_bits[2], channel_bits[3]);
+        print(", \"predictor_rows\": [%llu, %llu, %llu, %llu, %llu]", (unsigned long long)predictor_rows[0],
+              (unsigned long long)predictor_rows[1], (unsigned long long)predictor_rows[2], (unsigned long long)predictor_rows[3],
+              (unsigned long long)predictor_rows[4]);
+        print(", \"contexts_nb\": %zu, \"contexts_used\": %zu, \"states_adapted\": %llu, \"states_total\": %llu", context_hits.size(),
+              contextsUsed(), (unsigned long long)states_adapted, (unsigned long long)states_total);
+        out += ", \"contexts\": [";
+        bool first = true;
+        for (size_t c = 0; c < context_hits.size(); ++c) {
+            if (!context_hits[c]) continue;
+            print("%s[%zu, %llu, %.1f]", first ? "" : ", ", c, (unsigned long long)context_hits[c], context_bits[c]);
+            first = false;
+        }
+        print("], \"phase_ns\": {\"modelling\": %llu, \"coding\": %llu, \"output\": %llu}, \"wall_ns\": %llu",
+              (unsigned long long)phase_ns[Modelling], (unsigned long long)phase_ns[Coding], (unsigned long long)phase_ns[Output],
+              (unsigned long long)wall_ns);
+        out += ", \"row_ns\": [";
+        for (size_t y = 0; y < row_ns.size(); ++y) print("%s%llu", y ? ", " : "", (unsigned long long)row_ns[y]);
+        out += "]}";
+        return out;
+    }
+
+private:
+    void flagBit(Stage stage, Coder coder, bool bit, uint8_t p) {
+        if (coder == Coder::GolombRice) {
+            stage_bits[stage] += 1;
+        } else {
+            ++bins;
+            stage_bits[stage] += binBits(bit, p);
+        }
+    }
+
+    void hit(int context) {
+        if (size_t(context) >= context_hits.size()) {
+            context_hits.resize(context + 1);
+            context_bits.resize(context + 1);
+        }
+        ++context_hits[context];
+        ++residuals;
+    }
+
+    /// Decision of residual state `state`, run through a copy of the state per initial state.
+    void opening(size_t state, bool bit) {
+        if (state >= opening_seen.size()) {
+            opening_seen.resize(state + 1);
+            opening_slices.resize(std::max(opening_slices.size(), state + 1));
+            opening_bits.resize(std::max(opening_bits.size(), (state + 1) * 128));
+            opening_states.resize((state + 1) * 128);
+        }
+        if (opening_seen[state] >= train_window) return;
+        if (opening_seen[state]++ == 0) {
+            ++opening_slices[state];
+            for (int i = 0; i < 128; ++i) opening_states[state * 128 + i].state = uint8_t(i);
+        }
+        for (size_t i = state * 128; i < state * 128 + 128; ++i) {
+            opening_bits[i] += binBits(bit, opening_states[i].P());
+            opening_states[i].update(bit);
+        }
+    }
+
+    std::vector<int> opening_seen; // decisions of each state in the current slice
+    std::vector<cabac::State> opening_states;
+};
+
+/// Nanosecond timestamp for CodecStats; 0 without LLCOMP_STATS.
+inline uint64_t statsClock() {
+    if constexpr (stats_enabled) {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    return 0;
+}
+
+/**
+ * @brief Calls `count(CodecStats&)` when `stats` is set; compiled out without LLCOMP_STATS.
+ */
+template <typename Count>
+inline void recordStats(CodecStats* stats, Count&& count) {
+    if constexpr (stats_enabled) {
+        if (stats) count(*stats);
+    }
+}
+
+/**
+ * @brief CodecStats of the parts of a call coded in parallel, each part counting into its
+ *        own until finish() merges them; a single part counts into the target.
+ */
+struct PartStats {
+    PartStats(CodecStats* target, size_t parts) : target(stats_enabled ? target : nullptr), start(statsClock()) {
+        if (this->target && parts > 1) stats.resize(parts);
+        for (auto& part : stats) part.train_window = target->train_window;
+    }
+
+    CodecStats* operator[](size_t i) { return stats.empty() ? target : &stats[i]; }
+
+    /// Merges the parts into the target, with the duration of the whole call.
+    void finish() {
+        recordStats(target, [&](CodecStats& s) {
+            for (const auto& part : stats) s.merge(part);
+            s.wall_ns += statsClock() - start;
+        });
+    }
+
+    CodecStats* target;
+    uint64_t start;
+    std::vector<CodecStats> stats;
+};
+
+/**
+ * @brief Initial states of `model`, for InitialStates::Custom or llcomp_states.hpp, from the
+ *        stats of range-coded slices of that model coded with `train_window` set.
+ *
+ * Every state takes the initial state that coded its opening decisions in the fewest bits
+ * over all slices. States opened by fewer than `min_slices` slices keep state 0, which
+ * loses little on a rare state and does not fit the table to a handful of slices.
+ */
+inline std::vector<uint8_t> trainStates(const CodecStats& stats, Model model, int bit_depth = 8, uint32_t min_slices = 8) {
+    std::vector<uint8_t> table(getStatesNb(model, bit_depth));
+    for (size_t i = 0; i < table.size() && i < stats.opening_slices.size(); ++i) {
+        if (stats.opening_slices[i] < min_slices) continue;
+        const double* bits = stats.opening_bits.data() + i * 128;
+        table[i] = uint8_t(std::min_element(bits, bits + 128) - bits);
+    }
+    return table;
+}
+
+/**
+ * @brief Pixels of a row coded before its states are handed to the row below.
+ *
+ * Rows trail each other by this many pixels, so about four of them are decoded at once.
+ * Against a single stream, photos grow by 2 to 4% with the range coders; an eighth of the
+ * row would allow eight rows but costs twice that.
+ */
+inline uint32_t wavefrontSync(int width) {
+    return uint32_t(std::max(2, width / 4));
+}
+
+/**
+ * @brief Codes one slice as an independent image: own coder, own states, own lines.
+ *
+ * Rows are pushed one at a time, so the slice only ever holds three lines. The row
+ * kernel is specialized for the range coder, the context model and the channel count of
+ * the header, chosen once when the slice is created.
+ *
+ * In a wavefront slice every row is finished as a substream of its own, so the byte sink
+ * sees the end of a row when encodeRow() returns.
+ */
+template <typename PutByte>
+class SliceEncoder {
+public:
+    SliceEncoder(int width, const Header& header, PutByte put_byte)
+        : lines(width, header.channels), comp(put_byte), wide_comp(put_byte), golomb_comp(std::move(put_byte)) {
+        reset(width, header);
+    }
+
+    /**
+     * @brief Starts a new slice on the same byte sink.
+     *
+     * Buffers are resized in place and the states are refilled, so once they have grown to
+     * the largest slice seen, a reset does not allocate.
+     */
+    void reset(int width, const Header& header) {
+        const bool deep = header.bit_depth > 8;
+        if (header.planar && deep) {
+            encode_deep_plane_row = pickRowKernel(header, [](auto coder, auto model, auto) {
+                return &SliceEncoder::encodeRowT<decltype(coder)::value, decltype(model)::value, 1, int32_t>;
+            });
+        } else if (header.planar) {
+            encode_plane_row = pickRowKernel(header, [](auto coder, auto model, auto) {
+                return &SliceEncoder::encodeRowT<decltype(coder)::value, decltype(model)::value, 1, int16_t>;
+            });
+        } else if (deep) {
+            encode_deep_row = pickRowKernel(header, [](auto coder, auto model, auto channels) {
+                return &SliceEncoder::encodeRowT<decltype(coder)::value, decltype(model)::value, decltype(channels)::value, uint16_t>;
+            });
+        } else {
+            encode_row = pickRowKernel(header, [](auto coder, auto model, auto channels) {
+                return &SliceEncoder::encodeRowT<decltype(coder)::value, decltype(model)::value, decltype(channels)::value, uint8_t>;
+            });
+        }
+        const int channels = header.planar ? 1 : header.channels;
+        this->width = width;
+        coder = header.coder;
+        run_mode = header.run_mode;
+        adaptive = header.adaptive_predictor;
+        bit_depth = header.bit_depth;
+        wavefront = header.wavefront_sync != 0;
+        snapshot_at = wavefront ? int(std::min<uint32_t>(header.wavefront_sync, width)) : INT_MAX;
+        h = 0;
+        if (deep) {
+            deep_lines.reset(width, channels);
+            deep_res.resize(size_t(width) * channels);
+        } else {
+            lines.reset(width, channels);
+            res.resize(size_t(width) * channels);
+        }
+        ctx.resize(size_t(width) * channels);
+        states.reset(header);
+        comp.reset();
+        wide_comp.reset();
+        golomb_comp.reset();
+        golomb_comp.setBitDepth(bit_depth);
+    }
+
+    /**
+     * @brief Codes one row of `width * channels` interleaved samples.
+     */
+    void encodeRow(const uint8_t* row) { codeRow(encode_row, row); }
+
+    /// Same for a slice of a stream above 8 bits.
+    void encodeRow(const uint16_t* row) { codeRow(encode_deep_row, row); }
+
+    /**
+     * @brief Codes one row of a plane of a planar slice: `width` samples after the colour
+     *        transform, see transformPlaneRow().
+     */
+    void encodePlaneRow(const int16_t* samples) { codeRow(encode_plane_row, samples); }
+
+    /// Same for a slice of a stream above 8 bits.
+    void encodePlaneRow(const int32_t* samples) { codeRow(encode_deep_plane_row, samples); }
+
+    void finish() {
+        if (!wavefront) finishCoder();
+        recordStats(stats, [&](CodecStats& s) { s.countStates(states); });
+    }
+
+    /**
+     * @brief Counts what the slice codes into `stats` from now on, or stops for nullptr.
+     * @param first_row Image row of the first row of the slice.
+     * @param plane Channel of a planar slice.
+     */
+    void collect(CodecStats* stats, int first_row = 0, int plane = 0) {
+        this->stats = stats;
+        stats_row = first_row;
+        stats_channel = plane;
+    }
+
+    /// States the slice codes with; a sequence frame swaps in those its slice left behind.
+    ContextStates& contextStates() { return states; }
+
+private:
+    template <typename Sample>
+    void codeRow(void (SliceEncoder::*kernel)(const Sample*), const Sample* row) {
+        const uint64_t start = modelled = statsClock();
+        if (wavefront && h > 0) {
+            states = snapshot;
+            comp.reset();
+            wide_comp.reset();
+            golomb_comp.reset();
+        }
+        (this->*kernel)(row);
+        if (wavefront) finishCoder();
+        recordRow(start);
+        ++h;
+    }
+
+    /// Lines of the kernels coding into `Line` samples.
+    template <typename Line>
+    BasicLineRing<Line>& lineRing() {
+        if constexpr (std::is_same_v<Line, int32_t>) {
+            return deep_lines;
+        } else {
+            return lines;
+        }
+    }
+
+    template <typename Line>
+    std::vector<Line>& residuals() {
+        if constexpr (std::is_same_v<Line, int32_t>) {
+            return deep_res;
+        } else {
+            return res;
+        }
+    }
+
+    void recordRow(uint64_t start) {
+        recordStats(stats, [&](CodecStats& s) {
+            const uint64_t end = statsClock();
+            s.phase(CodecStats::Modelling, modelled - start);
+            s.phase(CodecStats::Coding, end - modelled);
+            s.row(stats_row + h, end - start);
+        });
+    }
+
+    void finishCoder() {
+        switch (coder) {
+            case Coder::WideRange: wide_comp.finish(); break;
+            case Coder::GolombRice: golomb_comp.finish(); break;
+            default: comp.finish(); break;
+        }
+    }
+
+    template <Coder K, Model M, int C, typename Sample>
+    void encodeRowT(const Sample* row) {
+        if (h == 0) {
+            encodeRowT<K, M, C, Sample, true>(row);
+        } else {
+            encodeRowT<K, M, C, Sample, false>(row);
+        }
+    }
+
+    template <Coder K, Model M, int C, typename Sample, bool FirstRow>
+    void encodeRowT(const Sample* row) {
+        // samples above 8 bits are modelled by the scalar code, with scaled gradients
+        using Line = LineSample<Sample>;
+        constexpr bool deep = std::is_same_v<Line, int32_t>;
+        const int shift = deep ? bit_depth - 8 : 0;
+        auto& lines = lineRing<Line>();
+        auto& res = residuals<Line>();
+        Line* line0 = lines.line(h);
+        const Line* line1 = lines.line(h - 1);
+        const Line* line2 = h > 1 ? lines.line(h - 2) : line1;
+        for (int i = 0; i < C; i++) {
+            line0[i - 2 * C] = line0[i - C] = FirstRow ? 128 << shift : line1[i];
+        }
+
+        for (int w = 0; w < width; ++w) {
+            const int x = w * C;
+            const Sample* px = row + x;
+            if constexpr (C >= 3) {
+                int r = px[0];
+                int g = px[1];
+                int b = px[2];
+                b -= g;
+                r -= g;
+                g += (b + r) / 4;
+
+                line0[x + 0] = r;
+                line0[x + 1] = g;
+                line0[x + 2] = b;
+                for (int i = 3; i < C; i++) {
+                    line0[x + i] = px[i];
+                }
+            } else {
+                for (int i = 0; i < C; i++) {
+                    line0[x + i] = px[i];
+                }
+            }
+        }
+        if (width == 0) return;
+
+        // model the whole row; pixel 0 goes first since it is the only one seeing the left pads
+        const int n = width * C;
+        for (int i = 0; i < C; i++) line0[width * C + i] = line0[(width - 1) * C + i];
+        const Predictor predictor = !FirstRow && adaptive ? pickPredictor<C>(line0, line1, line2, width, shift) : Predictor::Med;
+        auto modelRow = [&](auto p) {
+            constexpr Predictor P = decltype(p)::value;
+            auto modelSamples = [&](int begin, int end) {
+                for (int x = begin; x < end; x++) {
+                    int hash, predict;
+                    predictSample<M, C, FirstRow, P>(line0 + x, line1 + x, line2 + x, hash, predict, shift);
+                    const int diff = line0[x] - predict;
+                    ctx[x] = hash < 0 ? -hash : hash;
+                    res[x] = hash < 0 ? -diff : diff;
+                }
+            };
+            modelSamples(0, C);
+            for (int i = 0; i < C; i++) line0[i - C] = line0[i];
+            // the SIMD kernels predict with MED
+            if constexpr (FirstRow || deep || P != Predictor::Med) {
+                modelSamples(C, n);
+            } else {
+                rowmodel::kernels().context[int(M)](line0 + C, line1 + C, line2 + C, C, n - C, ctx.data() + C, res.data() + C);
+            }
+        };
+        if constexpr (FirstRow) {
+            modelRow(std::integral_constant<Predictor, Predictor::Med>{});
+        } else {
+            pickPredictorKernel(predictor, modelRow);
+        }
+        if constexpr (stats_enabled) modelled = statsClock();
+        if (!FirstRow && adaptive) encodePredictor<K>(predictor);
+
+        auto encodeSample = [&](int x) {
+            const int context = ctx[x];
+            if constexpr (K == Coder::GolombRice) {
+                recordStats(stats, [&](CodecStats& s) {
+                    s.golombCode(context, stats_channel + x % C, golomb::codeLength(res[x], states.golomb[context], bit_depth));
+                });
+                golomb_comp.put(res[x], states.golomb[context]);
+            } else {
+                using Symbol = SymbolContexts<deep>;
+                cabac::State* base = states.bins.data() + context * Symbol::substates;
+                binarization::putSymbol<true,Symbol::e_lim,Symbol::r_lim,Symbol::s_bit>(int(res[x]),[&](int ctx, bool bit) {
+                   auto& state = base[ctx];
+                   recordStats(stats, [&](CodecStats& s) { s.bin<Symbol>(context, stats_channel + x % C, ctx, bit, state.P()); });
+                   rangeCoder<K>().put(bit, state.P());
+                   state.update(bit);
+                });
+            }
+        };
+        // a wavefront row hands its states on after snapshot_at pixels
+        if (!run_mode) {
+            const int split = std::min(snapshot_at, width);
+            for (int x = 0; x < split * C; ++x) {
+                encodeSample(x);
+            }
+            if (split == snapshot_at) snapshot = states;
+            for (int x = split * C; x < n; ++x) {
+                encodeSample(x);
+            }
+            return;
+        }
+        auto sameAsLeft = [&](int w) {
+            for (int i = 0; i < C; ++i) {
+                if (line0[w * C + i] != line0[(w - 1) * C + i]) return false;
+            }
+            return true;
+        };
+        // a run may jump over snapshot_at, the states are then taken at the next pixel
+        int snapshot_w = snapshot_at;
+        for (int w = 0; w < width; ++w) {
+            if (w >= snapshot_w) {
+                snapshot = states;
+                snapshot_w = INT_MAX;
+            }
+            if (w > 0 && flatContext<C>(ctx.data() + w * C)) {
+                int run = 0;
+                while (w + run < width && sameAsLeft(w + run)) ++run;
+                encodeRun<K>(run, width - w);
+                w += run;
+                if (w == width) break;
+            }
+            for (int i = 0; i < C; ++i) {
+                encodeSample(w * C + i);
+            }
+        }
+        if (snapshot_w <= width) snapshot = states;
+    }
+
+    /**
+     * @brief Predictor for a row past the first, the one whose residuals take the fewest bits.
+     *
+     * The bits of a residual are estimated by its bit length, over every `predictor_stride`th
+     * pixel, the row being colour transformed and padded on the right but not on the left
+     * yet. The contexts are trained on MED residuals, so another predictor has to save more
+     * than a quarter bit per inspected sample; below that the estimated gains were coding
+     * losses. Among the others, the one listed first wins ties.
+     */
+    template <int C, typename Line>
+    static Predictor pickPredictor(const Line* line0, const Line* line1, const Line* line2, int width, int shift) {
+        auto cost = [&](auto p) {
+            uint64_t bits = 0;
+            for (int w = 2; w < width; w += predictor_stride) {
+                for (int x = w * C; x < (w + 1) * C; ++x) {
+                    const int predict = predictFrom<decltype(p)::value>(line0[x - C], line0[x - 2 * C], line1[x], line1[x - C],
+                                                                        line1[x + C], line2[x], line2[x + C], shift);
+                    bits += binarization::ilog2_32<binarization::UnsafeBehavior>(uint32_t(2 * std::abs(line0[x] - predict) + 1));
+                }
+            }
+            return bits;
+        };
+        const uint64_t margin = uint64_t(std::max(width - 2 + predictor_stride - 1, 0) / predictor_stride) * C / 4;
+        const uint64_t med = cost(std::integral_constant<Predictor, Predictor::Med>{});
+        if (med <= margin) return Predictor::Med;
+        Predictor best = Predictor::Med;
+        uint64_t best_cost = med - margin;
+        for (int i = 1; i < predictors_nb; ++i) {
+            const uint64_t bits = pickPredictorKernel(Predictor(i), cost);
+            if (bits < best_cost) {
+                best = Predictor(i);
+                best_cost = bits;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * @brief Codes the predictor of a row, see predictor_states_nb.
+     */
+    template <Coder K>
+    void encodePredictor(Predictor predictor) {
+        recordStats(stats, [&](CodecStats& s) { s.rowPredictor(predictor); });
+        const bool change = predictor != states.predictor;
+        putPredictorBit<K>(change, states.predictor_bits[0]);
+        if (!change) return;
+        const int index = int(predictor) - (predictor > states.predictor);
+        putPredictorBit<K>(index >> 1, states.predictor_bits[1]);
+        putPredictorBit<K>(index & 1, states.predictor_bits[2 + (index >> 1)]);
+        states.predictor = predictor;
+    }
+
+    /**
+     * @brief Codes a run of `run` pixels, `remaining` being the pixels left in the row.
+     */
+    template <Coder K>
+    void encodeRun(int run, int remaining) {
+        recordStats(stats, [&](CodecStats& s) { s.run(run); });
+        int& run_index = states.run_index;
+        while (run >= 1 << run_order[run_index]) {
+            putRunBit<K>(true, states.run[run_index]);
+            run -= 1 << run_order[run_index];
+            remaining -= 1 << run_order[run_index];
+            if (run_index < run_contexts_nb - 1) ++run_index;
+        }
+        if (run == remaining) {
+            // the run reaches the end of the row
+            if (run > 0) putRunBit<K>(true, states.run[run_index]);
+            return;
+        }
+        putRunBit<K>(false, states.run[run_index]);
+        for (int b = run_order[run_index] - 1; b >= 0; --b) {
+            putRunBit<K>((run >> b) & 1, states.run_bits[b]);
+        }
+        if (run_index > 0) --run_index;
+    }
+
+    template <Coder K>
+    void putRunBit(bool bit, cabac::State& state) {
+        recordStats(stats, [&](CodecStats& s) { s.runBit(K, bit, state.P()); });
+        putFlag<K>(bit, state);
+    }
+
+    template <Coder K>
+    void putPredictorBit(bool bit, cabac::State& state) {
+        recordStats(stats, [&](CodecStats& s) { s.predictorBit(K, bit, state.P()); });
+        putFlag<K>(bit, state);
+    }
+
+    /// Decision outside the residuals: adaptive with the range coders, a raw bit with Golomb-Rice.
+    template <Coder K>
+    void putFlag(bool bit, cabac::State& state) {
+        if constexpr (K == Coder::GolombRice) {
+            golomb_comp.putBits(1, bit);
+        } else {
+            rangeCoder<K>().put(bit, state.P());
+            state.update(bit);
+        }
+    }
+
+    template <Coder K>
+    auto& rangeCoder() {
+        if constexpr (K == Coder::WideRange) {
+            return wide_comp;
+        } else {
+            return comp;
+        }
+    }
+
+    int width;
+    int h{0};
+    Coder coder{Coder::Range};
+    bool run_mode{false};
+    bool adaptive{false}; // rows code their Predictor
+    int bit_depth{8};
+    bool wavefront{false};
+    int snapshot_at{INT_MAX}; // pixel at which a wavefront row takes its snapshot
+    LineRing lines;
+    BasicLineRing<int32_t> deep_lines{0, 1}; // lines of a stream above 8 bits
+    std::vector<int16_t> ctx; // |hash| and residual of the row being coded
+    std::vector<int16_t> res;
+    std::vector<int32_t> deep_res;
+    ContextStates states;
+    ContextStates snapshot; // states handed to the next wavefront row
+    CodecStats* stats{nullptr};
+    int stats_row{0}; // image row of the first row
+    int stats_channel{0};
+    uint64_t modelled{0}; // when the row being coded was modelled, for the stats
+    RangeEncoder<PutByte> comp;
+    WideRangeEncoder<PutByte> wide_comp;
+    GolombRiceEncoder<PutByte> golomb_comp;
+    void (SliceEncoder::*encode_row)(const uint8_t*);
+    void (SliceEncoder::*encode_plane_row)(const int16_t*);
+    void (SliceEncoder::*encode_deep_row)(const uint16_t*);
+    void (SliceEncoder::*encode_deep_plane_row)(const int32_t*);
+};
+
+/**
+ * @brief Lines and progress shared by the SliceDecoders of a wavefront slice whose rows are
+ *        decoded concurrently.
+ *
+ * The ring holds a line per decoder plus the two rows above the oldest row in flight.
+ * `progress[y]` counts the finished pixels of row y. It is stored with release ordering
+ * after those pixels, and after the snapshot once it reaches the sync point, so a single
+ * snapshot slot is enough: row y + 1 copies it before it can take its own.
+ */
+struct WavefrontRows {
+    static constexpr int report_step = 64; // pixels between two progress reports
+
+    WavefrontRows(int width, int height, int channels, int decoders)
+        : lines(width, channels, decoders + 2), progress(new std::atomic<int>[size_t(height)]) {
+        for (int y = 0; y < height; ++y) progress[y].store(0, std::memory_order_relaxed);
+    }
+
+    void report(int y, int pixels) { progress[y].store(pixels, std::memory_order_release); }
+
+    /// Waits until row y has finished `pixels` pixels and returns its progress.
+    int wait(int y, int pixels) const {
+        int done;
+        while ((done = progress[y].load(std::memory_order_acquire)) < pixels) {
+            if (failed.load(std::memory_order_relaxed)) {
+                throw std::runtime_error("Wavefront row failed");
+            }
+            std::this_thread::yield();
+        }
+        return done;
+    }
+
+    LineRing lines;
+    ContextStates snapshot;
+    std::unique_ptr<std::atomic<int>[]> progress;
+    std::atomic<bool> failed{false};
+};
+
+/**
+ * @brief Lines of a slice handed from its entropy stage to its output stage.
+ *
+ * The entropy stage decodes into a ring of `depth` lines and only reuses the line of a
+ * row once it has been written. Whichever stage starts writing first owns the output: if
+ * the ring fills before the output task has started, the entropy stage writes the rows
+ * itself from then on, so the two tasks cannot deadlock whatever the pool size.
+ */
+struct RowPipeline {
+    static constexpr int depth = 16;
+    enum Writer : int { None, EntropyStage, OutputStage };
+
+    RowPipeline(int width, int channels) : lines(width, channels, depth) {}
+
+    bool claim(Writer stage) {
+        int none = None;
+        return writer.compare_exchange_strong(none, stage);
+    }
+
+    LineRing lines;
+    std::atomic<int> decoded{0}; // rows whose line is complete, stored with release ordering
+    std::atomic<int> written{0}; // rows written by the output stage
+    std::atomic<int> writer{None};
+    std::atomic<bool> failed{false};
+};
+
+/**
+ * @brief Decodes one slice produced by SliceEncoder, one row at a time.
+ *
+ * The row kernels only reconstruct the colour-transformed lines the prediction needs;
+ * decodeRow() then writes the row with outputRow(), and decodeLine() leaves that to a
+ * later stage. Rows of a wavefront slice go through decodeSubstream(). Decoders sharing
+ * a WavefrontRows decode them concurrently: a row only waits for the row above to be two
+ * pixels ahead.
+ */
+template <typename GetByte>
+class SliceDecoder {
+public:
+    SliceDecoder(int width, const Header& header, GetByte get_byte) : lines(width, header.channels) {
+        reset(width, header, std::move(get_byte));
+    }
+
+    /**
+     * @brief Starts decoding a new slice from `get_byte`, reusing the buffers like
+     *        SliceEncoder::reset().
+     */
+    void reset(int width, const Header& header, GetByte get_byte) {
+        // a plane of a planar slice is decoded as a single channel
+        if (header.bit_depth > 8) {
+            decode_line = pickRowKernel(header, [planar = header.planar](auto coder, auto model, auto channels) {
+                return planar ? &SliceDecoder::decodeLineT<decltype(coder)::value, decltype(model)::value, 1, int32_t>
+                              : &SliceDecoder::decodeLineT<decltype(coder)::value, decltype(model)::value, decltype(channels)::value, int32_t>;
+            });
+        } else {
+            decode_line = pickRowKernel(header, [planar = header.planar](auto coder, auto model, auto channels) {
+                return planar ? &SliceDecoder::decodeLineT<decltype(coder)::value, decltype(model)::value, 1, int16_t>
+                              : &SliceDecoder::decodeLineT<decltype(coder)::value, decltype(model)::value, decltype(channels)::value, int16_t>;
+            });
+        }
+        channels = header.planar ? 1 : header.channels;
+        this->width = width;
+        coder = header.coder;
+        run_mode = header.run_mode;
+        adaptive = header.adaptive_predictor;
+        bit_depth = header.bit_depth;
+        snapshot_at = header.wavefront_sync ? int(std::min<uint32_t>(header.wavefront_sync, width)) : INT_MAX;
+        h = 0;
+        if (bit_depth > 8) {
+            deep_lines.reset(width, channels);
+        } else {
+            lines.reset(width, channels);
+        }
+        top_ctx.resize(size_t(width) * channels);
+        states.reset(header);
+        golomb_decomp.setBitDepth(bit_depth);
+        resetCoder(std::move(get_byte));
+    }
+
+    /**
+     * @brief Decodes the next row into `width * channels` interleaved samples or, with a
+     *        `plane_stride` in bytes, into one plane per channel.
+     *
+     * Samples above 8 bits are written as `uint16_t`, see OutputLayout.
+     */
+    void decodeRow(uint8_t* row, size_t plane_stride = 0) {
+        const uint64_t start = statsClock();
+        decodeLine();
+        const uint64_t decoded = statsClock();
+        writePixels(0, width, row, plane_stride);
+        recordStats(stats, [&](CodecStats& s) {
+            const uint64_t end = statsClock();
+            s.phase(CodecStats::Coding, decoded - start);
+            s.phase(CodecStats::Output, end - decoded);
+            s.row(stats_row + h - 1, end - start);
+        });
+    }
+
+    /**
+     * @brief Writes pixels [x, x + count) of the last decoded row like decodeRow(), e.g.
+     *        the part of the slice inside a region.
+     */
+    void writePixels(int x, int count, uint8_t* row, size_t plane_stride = 0) {
+        if (bit_depth > 8) {
+            outputRow(deep_lines.line(h - 1) + x * channels, count, channels, reinterpret_cast<uint16_t*>(row), plane_stride / 2,
+                      (1 << bit_depth) - 1);
+        } else {
+            outputRow(line(h - 1) + x * channels, count, channels, row, plane_stride);
+        }
+    }
+
+    /**
+     * @brief Decodes the next row of a plane of a planar slice into `width` samples, still
+     *        colour transformed.
+     */
+    void decodePlaneRow(int16_t* samples) { decodePlaneRow(lines, samples); }
+
+    /// Same for a slice of a stream above 8 bits.
+    void decodePlaneRow(int32_t* samples) { decodePlaneRow(deep_lines, samples); }
+
+    /**
+     * @brief Decodes the next row into the lines only, leaving the output to outputRow().
+     */
+    void decodeLine() {
+        (this->*decode_line)();
+        ++h;
+    }
+
+    /**
+     * @brief Colour-transformed samples of row `y`, while the lines still hold it.
+     */
+    const int16_t* line(int y) { return (ring ? *ring : lines).line(y); }
+
+    /**
+     * @brief Decodes row `y` of a wavefront slice from its own substream `get_byte`.
+     *
+     * On its own, a decoder takes the rows in order. With shared rows it takes any row not
+     * taken by another decoder, waiting for the row above to hand over its states.
+     */
+    void decodeSubstream(int y, uint8_t* row, GetByte get_byte, size_t plane_stride = 0) {
+        h = y;
+        if (y > 0) {
+            if (shared) {
+                shared->wait(y - 1, snapshot_at);
+                states = shared->snapshot;
+            } else {
+                states = snapshot;
+            }
+        }
+        resetCoder(std::move(get_byte));
+        decodeRow(row, plane_stride);
+        // the line may be reused once the row below knows this one is done
+        if (shared) shared->report(y, width);
+    }
+
+    /// Decodes into the lines of `rows` from now on, or into its own lines for nullptr.
+    void share(WavefrontRows* rows) {
+        shared = rows;
+        ring = rows ? &rows->lines : nullptr;
+    }
+
+    /**
+     * @brief Decodes into `lines` from now on, e.g. a ring deep enough for an output stage
+     *        running behind; nullptr goes back to the own three lines.
+     */
+    void decodeInto(LineRing* lines) { ring = lines; }
+
+    /// See SliceEncoder::contextStates().
+    ContextStates& contextStates() { return states; }
+
+    /// See SliceEncoder::collect(). Rows left to outputRow() are only timed up to their
+    /// colour-transformed lines.
+    void collect(CodecStats* stats, int first_row = 0, int plane = 0) {
+        this->stats = stats;
+        stats_row = first_row;
+        stats_channel = plane;
+    }
+
+    /// Counts the occupancy of the state table at the end of the slice.
+    void finish() {
+        recordStats(stats, [&](CodecStats& s) { s.countStates(states); });
+    }
+
+private:
+    template <typename Line>
+    void decodePlaneRow(BasicLineRing<Line>& lines, Line* samples) {
+        const uint64_t start = statsClock();
+        decodeLine();
+        std::copy_n(lines.line(h - 1), width, samples);
+        recordStats(stats, [&](CodecStats& s) {
+            const uint64_t ns = statsClock() - start;
+            s.phase(CodecStats::Coding, ns);
+            s.row(stats_row + h - 1, ns);
+        });
+    }
+
+    /// See SliceEncoder::lineRing(); 8-bit lines may come from outside.
+    template <typename Line>
+    BasicLineRing<Line>& lineRing() {
+        if constexpr (std::is_same_v<Line, int32_t>) {
+            return deep_lines;
+        } else {
+            return ring ? *ring : lines;
+        }
+    }
+
+    /// Part of the hash coming from the rows above, for the samples [begin, end) of the row.
+    template <Model M, typename Line>
+    void modelTop(const Line* line1, const Line* line2, int C, int begin, int end) {
+        if constexpr (std::is_same_v<Line, int32_t>) {
+            const int shift = bit_depth - 8;
+            for (int x = begin; x < end; ++x) {
+                top_ctx[x] = topHash<M>(line1[x], line1[x - C], line1[x + C], line2[x], shift);
+            }
+        } else {
+            rowmodel::kernels().top_context[int(M)](line1 + begin, line2 + begin, C, end - begin, top_ctx.data() + begin);
+        }
+    }
+
+    void resetCoder(GetByte get_byte) {
+        // only the coder of the stream reads its first bytes
+        switch (coder) {
+            case Coder::WideRange: wide_decomp.reset(std::move(get_byte)); break;
+            case Coder::GolombRice: golomb_decomp.reset(std::move(get_byte)); break;
+            default: decomp.reset(std::move(get_byte)); break;
+        }
+    }
+
+    /**
+     * @brief Waits for the row above to be two pixels ahead of `w`, then models the top
+     *        context of its pixels from `ready` on.
+     * @return End of the pixels whose top context is known.
+     */
+    template <Model M, int C, typename Line>
+    int awaitAbove(int w, int ready, const Line* line1, const Line* line2) {
+        const int above = shared->wait(h - 1, std::min(w + 2, width));
+        // the top-right neighbour of the last finished pixel is still missing
+        const int end = above == width ? width : above - 1;
+        modelTop<M>(line1, line2, C, ready * C, end * C);
+        return end;
+    }
+
+    template <Coder K, Model M, int C, typename Line>
+    void decodeLineT() {
+        if (h == 0) {
+            decodeLineT<K, M, C, Line, true, Predictor::Med>();
+        } else if (adaptive && width > 0) {
+            pickPredictorKernel(decodePredictor<K>(), [&](auto p) { decodeLineT<K, M, C, Line, false, decltype(p)::value>(); });
+        } else {
+            decodeLineT<K, M, C, Line, false, Predictor::Med>();
+        }
+    }
+
+    template <Coder K, Model M, int C, typename Line, bool FirstRow, Predictor P>
+    void decodeLineT() {
+        const int shift = std::is_same_v<Line, int32_t> ? bit_depth - 8 : 0;
+        auto& lines = lineRing<Line>();
+        Line* line0 = lines.line(h);
+        const Line* line1 = lines.line(h - 1);
+        const Line* line2 = h > 1 ? lines.line(h - 2) : line1;
+        for (int i = 0; i < C; i++) {
+            line0[i - 2 * C] = line0[i - C] = FirstRow ? 128 << shift : line1[i];
+        }
+
+        // pixels whose top context is known; with shared rows it follows the row above
+        int ready = width;
+        if (!FirstRow) {
+            if (shared) {
+                ready = 0;
+            } else {
+                modelTop<M>(line1, line2, C, 0, width * C);
+            }
+        }
+
+        // the context of a sample only depends on earlier pixels, so a whole pixel is
+        // modelled before its samples are decoded
+        int hashes[C], predicts[C];
+        auto modelPixel = [&](int w) {
+            const int x = w * C;
+            for (int i = 0; i < C; ++i) {
+                if constexpr (FirstRow) {
+                    predictSample<M, C, true>(line0 + x + i, line1 + x + i, line2 + x + i, hashes[i], predicts[i], shift);
+                } else {
+                    const int l = line0[x + i - C];
+                    const int L = line0[x + i - 2 * C];
+                    const int t = line1[x + i];
+                    const int tl = line1[x + i - C];
+                    hashes[i] = top_ctx[x + i] + leftHash<M>(l, L, tl, shift);
+                    predicts[i] = predictFrom<P>(l, L, t, tl, line1[x + i + C], line2[x + i], line2[x + i + C], shift);
+                }
+            }
+        };
+
+        auto decodePixel = [&](int w) {
+            const int x = w * C;
+            for (int i = 0; i < C; ++i) {
+                int hash = hashes[i];
+                const int predict = predicts[i];
+                bool neg_diff = false;
+                if (hash < 0) {
+                    hash = -hash;
+                    neg_diff = true;
+                }
+
+                int diff;
+                if constexpr (K == Coder::GolombRice) {
+                    const golomb::State before = states.golomb[hash];
+                    diff = golomb_decomp.get(states.golomb[hash]);
+                    recordStats(stats, [&](CodecStats& s) { s.golombCode(hash, stats_channel + i, golomb::codeLength(diff, before, bit_depth)); });
+                } else {
+                    using Symbol = SymbolContexts<std::is_same_v<Line, int32_t>>;
+                    cabac::State* base = states.bins.data() + hash * Symbol::substates;
+                    diff = binarization::getSymbol<true,Symbol::e_lim,Symbol::r_lim,Symbol::s_bit>([&](int ctx) {
+                        auto& state = base[ctx];
+                        const uint8_t p = state.P();
+                        bool bit = rangeDecoder<K>().get(p);
+                        recordStats(stats, [&](CodecStats& s) { s.bin<Symbol>(hash, stats_channel + i, ctx, bit, p); });
+                        state.update(bit);
+                        return bit;
+                     });
+                }
+
+
+                if (neg_diff) {
+                    diff = -diff;
+                }
+                // invalid data may hold any residual
+                line0[x + i] = Line(int64_t(predict) + diff);
+            }
+        };
+
+        if (width == 0) return;
+        // same snapshot point as SliceEncoder; shared rows also report their progress
+        ContextStates& handoff = shared ? shared->snapshot : snapshot;
+        int snapshot_w = snapshot_at;
+        int report_w = shared ? 0 : INT_MAX;
+        for (int w = 0; w < width; ++w) {
+            if (w >= snapshot_w) {
+                handoff = states;
+                snapshot_w = INT_MAX;
+                if (shared) report_w = w;
+            }
+            if (w >= report_w) {
+                shared->report(h, w);
+                report_w = w + WavefrontRows::report_step;
+            }
+            if (w >= ready) ready = awaitAbove<M, C>(w, ready, line1, line2);
+            modelPixel(w);
+            if (run_mode && w > 0 && flatContext<C>(hashes)) {
+                // the run repeats the left pixel, the pixel that ends it is coded as usual
+                const int run = decodeRun<K>(width - w);
+                for (int end = w + run; w < end; ++w) {
+                    for (int i = 0; i < C; ++i) line0[w * C + i] = line0[(w - 1) * C + i];
+                }
+                if (w == width) break;
+                if (run) {
+                    if (w >= ready) ready = awaitAbove<M, C>(w, ready, line1, line2);
+                    modelPixel(w);
+                }
+            }
+            decodePixel(w);
+            if (w == 0) {
+                for (int i = 0; i < C; i++) line0[i - C] = line0[i];
+            }
+        }
+        if (snapshot_w <= width) handoff = states;
+        for (int i = 0; i < C; i++) line0[width * C + i] = line0[(width - 1) * C + i];
+    }
+
+    /// Run length matching SliceEncoder::encodeRun(), at most `remaining`.
+    template <Coder K>
+    int decodeRun(int remaining) {
+        int& run_index = states.run_index;
+        int run = 0;
+        while (getRunBit<K>(states.run[run_index])) {
+            const int n = std::min(1 << run_order[run_index], remaining - run);
+            run += n;
+            if (n == 1 << run_order[run_index] && run_index < run_contexts_nb - 1) ++run_index;
+            if (run == remaining) {
+                recordStats(stats, [&](CodecStats& s) { s.run(run); });
+                return run;
+            }
+        }
+        int rest = 0;
+        for (int b = run_order[run_index] - 1; b >= 0; --b) {
+            rest = rest << 1 | int(getRunBit<K>(states.run_bits[b]));
+        }
+        if (run_index > 0) --run_index;
+        run = std::min(run + rest, remaining);
+        recordStats(stats, [&](CodecStats& s) { s.run(run); });
+        return run;
+    }
+
+    /// Predictor of the row matching SliceEncoder::encodePredictor().
+    template <Coder K>
+    Predictor decodePredictor() {
+        if (getPredictorBit<K>(states.predictor_bits[0])) {
+            const int high = getPredictorBit<K>(states.predictor_bits[1]);
+            const int index = high << 1 | int(getPredictorBit<K>(states.predictor_bits[2 + high]));
+            states.predictor = Predictor(index + (index >= int(states.predictor)));
+        }
+        recordStats(stats, [&](CodecStats& s) { s.rowPredictor(states.predictor); });
+        return states.predictor;
+    }
+
+    template <Coder K>
+    bool getRunBit(cabac::State& state) {
+        const uint8_t p = state.P();
+        const bool bit = getFlag<K>(state);
+        recordStats(stats, [&](CodecStats& s) { s.runBit(K, bit, p); });
+        return bit;
+    }
+
+    template <Coder K>
+    bool getPredictorBit(cabac::State& state) {
+        const uint8_t p = state.P();
+        const bool bit = getFlag<K>(state);
+        recordStats(stats, [&](CodecStats& s) { s.predictorBit(K, bit, p); });
+        return bit;
+    }
+
+    /// See SliceEncoder::putFlag().
+    template <Coder K>
+    bool getFlag(cabac::State& state) {
+        if constexpr (K == Coder::GolombRice) {
+            return golomb_decomp.getBits(1);
+        } else {
+            const bool bit = rangeDecoder<K>().get(state.P());
+            state.update(bit);
+            return bit;
+        }
+    }
+
+    template <Coder K>
+    auto& rangeDecoder() {
+        if constexpr (K == Coder::WideRange) {
+            return wide_decomp;
+        } else {
+            return decomp;
+        }
+    }
+
+    int width;
+    int channels{1}; // 1 for a plane of a planar slice
+    int h{0};
+    Coder coder{Coder::Range};
+    bool run_mode{false};
+    bool adaptive{false}; // rows code their Predictor
+    int bit_depth{8};
+    int snapshot_at{INT_MAX}; // pixel at which a wavefront row takes its snapshot
+    LineRing lines;
+    BasicLineRing<int32_t> deep_lines{0, 1}; // lines of a stream above 8 bits
+    LineRing* ring{nullptr}; // lines decoded into instead of the own ones
+    WavefrontRows* shared{nullptr}; // progress of concurrent rows
+    std::vector<int16_t> top_ctx; // hash part coming from the rows above
+    ContextStates states;
+    ContextStates snapshot;
+    CodecStats* stats{nullptr};
+    int stats_row{0}; // image row of the first row
+    int stats_channel{0};
+    RangeDecoder<GetByte> decomp;
+    WideRangeDecoder<GetByte> wide_decomp;
+    GolombRiceDecoder<GetByte> golomb_decomp;
+    void (SliceDecoder::*decode_line)();
+};
+
+/**
+ * @param rgb Top-left sample of the slice inside the interleaved image, `uint8_t` or, for a
+ *            header above 8 bits, `uint16_t`.
+ * @param image_stride Distance in samples between two image rows.
+ * @param row_end Called after every row, whose substream is complete in wavefront slices.
+ * @param carry States the slice starts from instead of the initial ones, replaced by
+ *              those it ends with (sequence frames).
+ * @param stats See SliceEncoder::collect().
+ */
+template <typename Sample, typename PutByte, typename RowEnd>
+inline void encodeSlice(const Sample* rgb, size_t image_stride, int width, int height, const Header& header, PutByte put_byte,
+                        RowEnd&& row_end, ContextStates* carry = nullptr, CodecStats* stats = nullptr, int first_row = 0) {
+    SliceEncoder slice(width, header, std::move(put_byte));
+    slice.collect(stats, first_row);
+    if (carry) std::swap(slice.contextStates(), *carry);
+    for (int h = 0; h < height; ++h) {
+        slice.encodeRow(rgb + h * image_stride);
+        row_end(h);
+    }
+    slice.finish();
+    if (carry) std::swap(slice.contextStates(), *carry);
+}
+
+/**
+ * @param pixels Top-left sample of the slice in the output, laid out as OutputLayout.
+ * @param pipeline Lines for writeSliceRows() running as another task, which then writes
+ *                 the rows instead.
+ */
+inline void decodeSlice(const uint8_t* data, size_t size, uint8_t* pixels, size_t image_stride, size_t plane_stride, int width, int height,
+                        const Header& header, ContextStates* carry = nullptr, RowPipeline* pipeline = nullptr,
+                        CodecStats* stats = nullptr, int first_row = 0) {
+    SliceDecoder slice(width, header, ByteReader{data, data + size});
+    slice.collect(stats, first_row);
+    if (carry) std::swap(slice.contextStates(), *carry);
+    if (!pipeline) {
+        for (int h = 0; h < height; ++h) {
+            slice.decodeRow(pixels + h * image_stride, plane_stride);
+        }
+    } else {
+        auto write = [&](int y) {
+            outputRow(slice.line(y), width, header.channels, pixels + y * image_stride, plane_stride);
+        };
+        try {
+            slice.decodeInto(&pipeline->lines);
+            bool writes = false;
+            for (int h = 0; h < height; ++h) {
+                // row h takes the line of row h - depth
+                while (!writes && pipeline->written.load(std::memory_order_acquire) <= h - RowPipeline::depth) {
+                    if (pipeline->claim(RowPipeline::EntropyStage)) {
+                        writes = true;
+                        for (int y = 0; y < h; ++y) write(y);
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+                slice.decodeLine();
+                if (writes) write(h);
+                pipeline->decoded.store(h + 1, std::memory_order_release);
+            }
+            // the output task has not started, all the lines are still there
+            if (!writes && pipeline->claim(RowPipeline::EntropyStage)) {
+                for (int y = 0; y < height; ++y) write(y);
+            }
+        } catch (...) {
+            pipeline->failed = true;
+            throw;
+        }
+    }
+    slice.finish();
+    if (carry) std::swap(slice.contextStates(), *carry);
+}
+
+/**
+ * @brief Output stage of a pipelined slice: writes the rows decodeSlice() hands over,
+ *        unless decodeSlice() already took the output over.
+ */
+inline void writeSliceRows(RowPipeline& pipeline, uint8_t* pixels, size_t image_stride, size_t plane_stride, int width, int height,
+                           int channels) {
+    if (!pipeline.claim(RowPipeline::OutputStage)) return;
+    for (int y = 0; y < height; ++y) {
+        while (pipeline.decoded.load(std::memory_order_acquire) <= y) {
+            if (pipeline.failed.load(std::memory_order_relaxed)) return;
+            std::this_thread::yield();
+        }
+        outputRow(pipeline.lines.line(y), width, channels, pixels + y * image_stride, plane_stride);
+        pipeline.written.store(y + 1, std::memory_order_release);
+    }
+}
+
+/**
+ * @brief Channel `plane` of a row of interleaved pixels after the colour transform, as
+ *        coded by a planar slice: `int16_t` samples for `uint8_t` pixels, `int32_t` for
+ *        `uint16_t` ones.
+ */
+template <typename Sample>
+inline void transformPlaneRow(const Sample* row, int width, int channels, int plane, LineSample<Sample>* samples) {
+    if (channels < 3 || plane >= 3) {
+        for (int w = 0; w < width; ++w) samples[w] = row[w * channels + plane];
+        return;
+    }
+    for (int w = 0; w < width; ++w) {
+        const Sample* px = row + w * channels;
+        const int r = px[0] - px[1];
+        const int b = px[2] - px[1];
+        samples[w] = plane == 0 ? r : plane == 2 ? b : px[1] + (b + r) / 4;
+    }
+}
+
+/**
+ * @brief Writes a row of decoded planes as pixels, undoing the colour transform.
+ * @param planes Row of plane 0; the row of plane i is `i * plane_stride` samples further.
+ * @param out_plane_stride 0 to interleave the samples into `row`, otherwise the distance
+ *                         between two output planes.
+ */
+inline void combinePlaneRow(const int16_t* planes, size_t plane_stride, int width, int channels, uint8_t* row, size_t out_plane_stride = 0) {
+    const size_t step = out_plane_stride ? 1 : channels;
+    const size_t next = out_plane_stride ? out_plane_stride : 1;
+    for (int w = 0; w < width; ++w) {
+        uint8_t* px = row + w * step;
+        int i = 0;
+        if (channels >= 3) {
+            int r = planes[w];
+            int g = planes[plane_stride + w];
+            int b = planes[2 * plane_stride + w];
+            g -= ((r + b) / 4);
+            r += g;
+            b += g;
+            px[0] = std::max(0, std::min(255, r));
+            px[next] = std::max(0, std::min(255, g));
+            px[2 * next] = std::max(0, std::min(255, b));
+            i = 3;
+        }
+        for (; i < channels; ++i) {
+            px[i * next] = uint8_t(planes[i * plane_stride + w]);
+        }
+    }
+}
+
+/**
+ * @brief combinePlaneRow() for samples above 8 bits, clamped to `maxval`; the output
+ *        plane stride counts samples.
+ */
+inline void combinePlaneRow(const int32_t* planes, size_t plane_stride, int width, int channels, uint16_t* row, size_t out_plane_stride,
+                            int maxval) {
+    const size_t step = out_plane_stride ? 1 : channels;
+    const size_t next = out_plane_stride ? out_plane_stride : 1;
+    for (int w = 0; w < width; ++w) {
+        uint16_t* px = row + w * step;
+        int i = 0;
+        if (channels >= 3) {
+            int r = planes[w];
+            int g = planes[plane_stride + w];
+            int b = planes[2 * plane_stride + w];
+            g -= ((r + b) / 4);
+            r += g;
+            b += g;
+            px[0] = std::max(0, std::min(maxval, r));
+            px[next] = std::max(0, std::min(maxval, g));
+            px[2 * next] = std::max(0, std::min(maxval, b));
+            i = 3;
+        }
+        for (; i < channels; ++i) {
+            px[i * next] = uint16_t(planes[i * plane_stride + w]);
+        }
+    }
+}
+
+/**
+ * @brief Codes channel `plane` of a slice of a planar stream.
+ */
+template <typename Sample, typename PutByte>
+inline void encodePlane(const Sample* rgb, size_t image_stride, int width, int height, int plane, const Header& header, PutByte put_byte,
+                        ContextStates* carry = nullptr, CodecStats* stats = nullptr, int first_row = 0) {
+    SliceEncoder slice(width, header, std::move(put_byte));
+    slice.collect(stats, first_row, plane);
+    if (carry) std::swap(slice.contextStates(), *carry);
+    std::vector<LineSample<Sample>> samples(width);
+    for (int h = 0; h < height; ++h) {
+        transformPlaneRow(rgb + h * image_stride, width, header.channels, plane, samples.data());
+        slice.encodePlaneRow(samples.data());
+    }
+    slice.finish();
+    if (carry) std::swap(slice.contextStates(), *carry);
+}
+
+/**
+ * @param samples Top-left sample of the slice inside the plane, still colour transformed:
+ *                `int16_t`, or `int32_t` above 8 bits.
+ * @param plane_stride Distance in samples between two rows of the plane.
+ */
+template <typename Line>
+inline void decodePlane(const uint8_t* data, size_t size, Line* samples, size_t plane_stride, int width, int height, const Header& header,
+                        ContextStates* carry = nullptr, CodecStats* stats = nullptr, int first_row = 0, int plane = 0) {
+    SliceDecoder slice(width, header, ByteReader{data, data + size});
+    slice.collect(stats, first_row, plane);
+    if (carry) std::swap(slice.contextStates(), *carry);
+    for (int h = 0; h < height; ++h) {
+        slice.decodePlaneRow(samples + h * plane_stride);
+    }
+    slice.finish();
+    if (carry) std::swap(slice.contextStates(), *carry);
+}
+
+/**
+ * @brief Worst-case coded size in bytes of a slice of `samples` samples.
+ *
+ * After the RCT a residual stays within +-510, so an 8-bit sample takes at most 19 binary
+ * decisions: zero flag, 8 exponent bits and their stop bit, 8 mantissa bits and the sign.
+ * Each bit of depth above 8 doubles the range and adds an exponent and a mantissa bit.
+ * A single decision can cost 5.4 bits, but the state machine pays for that with cheap
+ * decisions first: starting from the initial state, no sequence of decisions averages
+ * more than 1.076 bits (its maximum mean cycle, coder rounding included). The bound uses
+ * 276/256 bits per decision, plus the bytes flushed by finish(). A Golomb-Rice code is
+ * at most golomb::limit + golomb::escapeBits() bits.
+ *
+ * Run mode adds at most one decision or bit per pixel on average: a chunk bit covers at
+ * least one pixel and every terminated run is followed by a coded pixel. Adaptive
+ * predictors add up to 3 decisions or bits for each of the `rows` rows of the samples.
+ * Initial states other than the default may start a state on the expensive side of that
+ * mean, by at most 15.2 bits, see wavefrontRowBound(), so each of them adds 2 bytes, up
+ * to 5.4 bits a decision.
+ */
+inline uint64_t sliceBound(const Header& header, uint64_t samples, uint64_t rows = 0) {
+    const uint64_t decisions = 2 * header.bit_depth + 3 + header.run_mode;
+    // in 1/2048 of a byte
+    const uint64_t sample_cost = header.coder == Coder::GolombRice
+        ? (golomb::limit + golomb::escapeBits(header.bit_depth) + header.run_mode) * 256 : decisions * 276;
+    const uint64_t row_cost = header.adaptive_predictor ? 3 * (header.coder == Coder::GolombRice ? 256 : 276) : 0;
+    const uint64_t bound = samples / 2048 * sample_cost + (samples % 2048 * sample_cost + 2047) / 2048 + (rows * row_cost + 2047) / 2048 + 8;
+    if (header.coder == Coder::GolombRice || header.initial_states == InitialStates::Default) return bound;
+    const uint64_t initial = 2 * getStatesNb(header.model, header.bit_depth);
+    return std::min(bound + initial, ((samples * decisions + 3 * rows * header.adaptive_predictor) * 1383 + 2047) / 2048 + 8);
+}
+
+/**
+ * @brief Worst-case coded size of a row of `samples` samples in a wavefront slice, past
+ *        its first row.
+ *
+ * Such a row starts from the states of the row above rather than the initial ones. They
+ * may have been reached by cheap decisions, leaving a state up to 15.2 bits above the
+ * 276/256 bits a decision, so every inherited state adds 2 bytes. The bound is capped at
+ * 5.4 bits a decision.
+ */
+inline uint64_t wavefrontRowBound(const Header& header, uint64_t samples) {
+    if (header.coder == Coder::GolombRice) return sliceBound(header, samples, 1);
+    const uint64_t inherited = 2 * (getStatesNb(header.model, header.bit_depth) + run_contexts_nb + 16 + predictor_states_nb);
+    const uint64_t decisions = samples * (2 * header.bit_depth + 3 + header.run_mode) + 3 * header.adaptive_predictor;
+    return std::min(sliceBound(header, samples, 1) + inherited, (decisions * 1383 + 2047) / 2048 + 8);
+}
+
+/**
+ * @brief Worst-case coded size of slice `r`, each row or plane flushed on its own in
+ *        wavefront or planar slices.
+ */
+inline uint64_t sliceBound(const Header& header, const Rect& r) {
+    if (header.planar) return header.channels * sliceBound(header, uint64_t(r.width) * r.height, r.height);
+    const uint64_t row = uint64_t(r.width) * header.channels;
+    if (!header.wavefront_sync || r.height == 0) return sliceBound(header, row * r.height, r.height);
+    return sliceBound(header, row, 1) + (r.height - 1) * wavefrontRowBound(header, row);
+}
+
+/**
+ * @brief Absolute offsets of the rows of a wavefront slice spanning [pos, end), plus its end.
+ */
+inline void rowOffsets(const Header& header, size_t pos, size_t end, std::vector<size_t>& offsets) {
+    offsets.resize(header.row_sizes.size() + 1);
+    offsets[0] = pos;
+    for (size_t y = 0; y < header.row_sizes.size(); ++y) {
+        if (header.row_sizes[y] > end - offsets[y]) {
+            throw std::runtime_error("Truncated slice data");
+        }
+        offsets[y + 1] = offsets[y] + header.row_sizes[y];
+    }
+}
+
+/**
+ * @brief Absolute offsets of the planes of planar slice `i` spanning [pos, end), plus its end.
+ */
+inline void planeOffsets(const Header& header, size_t i, size_t pos, size_t end, std::vector<size_t>& offsets) {
+    const size_t planes = header.channels;
+    offsets.resize(planes + 1);
+    offsets[0] = pos;
+    for (size_t p = 0; p + 1 < planes; ++p) {
+        const uint64_t size = header.plane_sizes[i * (planes - 1) + p];
+        if (size > end - offsets[p]) {
+            throw std::runtime_error("Truncated slice data");
+        }
+        offsets[p + 1] = offsets[p] + size;
+    }
+    offsets[planes] = end;
+}
+
+/**
+ * @brief Decodes the rows of a wavefront slice on `pool`, every task taking the next row.
+ *
+ * Rows are taken in order and a row only waits for rows taken before it, so the tasks
+ * cannot deadlock however many of them the pool runs at once.
+ */
+inline void decodeWavefront(const uint8_t* data, size_t size, const OutputLayout& out, const Header& header, ThreadPool& pool,
+                            CodecStats* stats = nullptr) {
+    const int width = header.width;
+    const int height = header.height;
+    std::vector<size_t> offsets;
+    rowOffsets(header, 0, size, offsets);
+
+    const size_t tasks = std::min<size_t>(pool.size(), height);
+    WavefrontRows rows(width, height, header.channels, int(tasks));
+    PartStats task_stats(stats, tasks);
+    std::atomic<int> next{0};
+    pool.parallel_for(tasks, [&](size_t i) {
+        try {
+            SliceDecoder slice(width, header, ByteReader{});
+            slice.share(&rows);
+            slice.collect(task_stats[i]);
+            for (int y; (y = next++) < height;) {
+                slice.decodeSubstream(y, out.pixels + y * out.row_stride, ByteReader{data + offsets[y], data + offsets[y + 1]},
+                                      out.plane_stride);
+                // the last row ends with the states of the whole slice
+                if (y == height - 1) slice.finish();
+            }
+        } catch (...) {
+            rows.failed = true;
+            throw;
+        }
+    });
+    task_stats.finish();
+}
+
+/**
+ * @brief Validates the image against its pixel buffer and fills the header fields that
+ *        do not depend on the coded slices.
+ */
+/**
+ * @brief Sets the initial states of `header`, whose coder and bit depth are set, from `options`.
+ *
+ * Without a model in the options, a custom table selects the model it was trained for.
+ */
+inline void initStates(Header& header, const EncodeOptions& options) {
+    header.initial_states = header.coder == Coder::GolombRice ? InitialStates::Default : options.initial_states;
+    header.custom_states.clear();
+    header.packed_states.clear();
+    if (header.initial_states == InitialStates::Trained && !trainedStates(header.model, header.bit_depth)) {
+        header.initial_states = InitialStates::Default;
+    }
+    if (header.initial_states != InitialStates::Custom) return;
+    for (int m = 0; m < models_nb && !options.model; ++m) {
+        if (getStatesNb(Model(m), header.bit_depth) == options.custom_states.size()) header.model = Model(m);
+    }
+    if (options.custom_states.size() != getStatesNb(header.model, header.bit_depth) ||
+        std::any_of(options.custom_states.begin(), options.custom_states.end(), [](uint8_t x) { return x > 127; })) {
+        throw std::invalid_argument("Custom states do not match the context model");
+    }
+    header.custom_states = options.custom_states;
+    packStates(header.custom_states, header.substates(), header.packed_states);
+}
+
+inline void initHeader(Header& header, size_t size, int width, int height, int channels, const EncodeOptions& options) {
+    if (width < 0 || height < 0 || channels < 1 || channels > 4 || int64_t(width) * channels > 0x7FFFFFFF) {
+        throw std::invalid_argument("Unsupported image dimensions");
+    }
+    if (size_t(width) * channels * height != size) {
+        throw std::invalid_argument("Pixel buffer does not match the image dimensions");
+    }
+    if (options.bit_depth < 8 || options.bit_depth > 16) {
+        throw std::invalid_argument("Unsupported bit depth");
+    }
+    header.width = width;
+    header.height = height;
+    header.channels = channels;
+    header.slice_cols = std::clamp(options.slice_cols, 1, std::clamp(width, 1, 0xFFFF));
+    header.slice_rows = std::clamp(options.slice_rows, 1, std::clamp(height, 1, 0xFFFF));
+    header.metadata.assign(options.metadata.begin(), options.metadata.end());
+    header.planar = options.planar && channels > 1;
+    header.model = options.model.value_or(pickModel(uint64_t(size) / header.slices() / (header.planar ? channels : 1)));
+    header.coder = options.coder;
+    header.run_mode = options.run_mode;
+    header.adaptive_predictor = options.adaptive_predictor;
+    header.bit_depth = uint8_t(options.bit_depth);
+    initStates(header, options);
+    header.index.clear();
+    header.wavefront_sync = 0;
+    header.row_sizes.clear();
+    if (options.wavefront) {
+        if (header.slices() > 1) {
+            throw std::invalid_argument("Wavefront rows need a single slice");
+        }
+        if (header.bit_depth > 8) {
+            throw std::invalid_argument("Wavefront rows need 8-bit samples");
+        }
+        header.wavefront_sync = wavefrontSync(width);
+        if (wavefrontRowBound(header, uint64_t(width) * channels) > UINT32_MAX) {
+            throw std::invalid_argument("Rows are too wide for wavefront coding");
+        }
+        header.row_sizes.assign(height, 0);
+    }
+    if (header.planar && header.wavefront_sync) {
+        throw std::invalid_argument("Wavefront rows and planar slices exclude each other");
+    }
+    header.plane_sizes.assign(header.planar ? header.slices() * (channels - 1) : 0, 0);
+}
+
+/**
+ * @brief Absolute offsets of the slices in a stream whose header ends at `pos`, plus the
+ *        end of the stream.
+ */
+inline void sliceOffsets(const Header& header, size_t pos, size_t size, std::vector<size_t>& offsets) {
+    offsets.assign(header.slices() + 1, size);
+    for (size_t i = 0; i < header.index.size(); ++i) {
+        if (header.index[i] > size - pos) {
+            throw std::runtime_error("Truncated slice data");
+        }
+        offsets[i] = pos + header.index[i];
+    }
+    offsets[0] = pos;
+}
+
+/**
+ * @brief Worst-case stream size for a header set up by initHeader(); sizes its index.
+ */
+inline size_t streamBound(Header& header) {
+    header.index.resize(header.slices());
+    uint64_t bound = header.size();
+    for (size_t i = 0; i < header.slices(); ++i) {
+        bound += sliceBound(header, header.slice(i));
+    }
+    return bound;
+}
+
+/**
+ * @brief Largest stream compressInto() can produce for these dimensions and options.
+ */
+inline size_t compressBound(int width, int height, int channels, const EncodeOptions& options = {}) {
+    Header header;
+    initHeader(header, size_t(width) * channels * height, width, height, channels, options);
+    return streamBound(header);
+}
+
+/**
+ * @brief Checks `size` samples against the bit depth of `options`: `uint8_t` samples are
+ *        coded at 8 bits, `uint16_t` ones at 9 to 16 bits and must stay below 2^bit_depth.
+ */
+template <typename Sample>
+inline void checkSamples(const Sample* pixels, size_t size, const EncodeOptions& options) {
+    if ((sizeof(Sample) == 1) != (options.bit_depth == 8)) {
+        throw std::invalid_argument("Sample type does not match the bit depth");
+    }
+    if (sizeof(Sample) == 2 && options.bit_depth < 16 &&
+        std::any_of(pixels, pixels + size, [&](Sample x) { return x >> options.bit_depth; })) {
+        throw std::invalid_argument("Sample exceeds the bit depth");
+    }
+}
+
+/**
+ * @brief Compresses straight into memory owned by the caller, e.g. a mapped file.
+ *
+ * Every slice gets a region of its worst-case size, so the coder writes without bounds
+ * checks; the slices are then moved down next to each other.
+ *
+ * @param capacity Size of `out`; must be at least compressBound().
+ * @return Size of the stream written at `out`.
+ */
+template <typename Sample>
+inline size_t compressSamples(const Sample* pixels, int width, int height, int channels, uint8_t* out, size_t capacity,
+                              const EncodeOptions& options) {
+    Header header;
+    initHeader(header, size_t(width) * channels * height, width, height, channels, options);
+    checkSamples(pixels, size_t(width) * channels * height, options);
+    if (capacity < compressBound(width, height, channels, options)) {
+        throw std::invalid_argument("Output buffer is smaller than compressBound()");
+    }
+    const size_t stride = size_t(width) * channels;
+    const size_t slices_nb = header.slices();
+    header.index.resize(slices_nb);
+    const size_t header_size = header.size();
+
+    // a planar slice is coded as one part per plane, any other slice as a single part
+    const size_t planes = header.planar ? channels : 1;
+    const size_t parts = slices_nb * planes;
+    std::vector<uint64_t> regions(parts + 1, header_size);
+    for (size_t i = 0; i < parts; ++i) {
+        const Rect r = header.slice(i / planes);
+        regions[i + 1] = regions[i] + (header.planar ? sliceBound(header, uint64_t(r.width) * r.height, r.height) : sliceBound(header, r));
+    }
+    std::vector<uint64_t> sizes(parts);
+    PartStats part_stats(options.stats, parts);
+    ThreadPool& pool = options.pool ? *options.pool : ThreadPool::shared();
+    pool.parallel_for(parts, [&](size_t i) {
+        const Rect r = header.slice(i / planes);
+        const Sample* rgb = pixels + r.y * stride + size_t(r.x) * channels;
+        uint8_t* p = out + regions[i];
+        auto put = [&p](uint8_t x) {
+            *p++ = x;
+        };
+        if (header.planar) {
+            encodePlane(rgb, stride, r.width, r.height, int(i % planes), header, put, nullptr, part_stats[i], r.y);
+        } else {
+            uint8_t* row_start = p;
+            encodeSlice(rgb, stride, r.width, r.height, header, put, [&](int y) {
+                if (header.wavefront_sync) header.row_sizes[y] = uint32_t(p - row_start);
+                row_start = p;
+            }, nullptr, part_stats[i], r.y);
+        }
+        sizes[i] = p - (out + regions[i]);
+    });
+    part_stats.finish();
+
+    uint64_t offset = 0;
+    for (size_t i = 0; i < parts; ++i) {
+        if (i % planes == 0) {
+            header.index[i / planes] = offset;
+        } else {
+            header.plane_sizes[i / planes * (planes - 1) + i % planes - 1] = sizes[i - 1];
+        }
+        std::memmove(out + header_size + offset, out + regions[i], sizes[i]);
+        offset += sizes[i];
+    }
+    uint8_t* p = out;
+    header.write([&p](uint8_t x) {
+        *p++ = x;
+    });
+    recordStats(options.stats, [&](CodecStats& s) {
+        s.raw_bytes += size_t(width) * channels * height * sizeof(Sample);
+        s.coded_bytes += header_size + offset;
+    });
+    return header_size + offset;
+}
+
+inline size_t compressInto(const uint8_t* pixels, int width, int height, int channels, uint8_t* out, size_t capacity,
+                           const EncodeOptions& options = {}) {
+    return compressSamples(pixels, width, height, channels, out, capacity, options);
+}
+
+/**
+ * @brief Same for samples of 9 to 16 bits, with `options.bit_depth` set to their depth.
+ */
+inline size_t compressInto(const uint16_t* pixels, int width, int height, int channels, uint8_t* out, size_t capacity,
+                           const EncodeOptions& options) {
+    return compressSamples(pixels, width, height, channels, out, capacity, options);
+}
+
+/**
+ * @brief Codes an image behind a header set up by initHeader(), the slices running on `pool`.
+ * @param carry For a sequence frame, the states of every slice, or of every plane of the
+ *              slices of a planar stream, in raster order.
+ */
+template <typename Sample>
+inline std::vector<uint8_t> encodeStream(const Sample* rgb, Header& header, ThreadPool& pool, ContextStates* carry = nullptr,
+                                         CodecStats* stats = nullptr) {
+    const int width = header.width;
+    const int channels = header.channels;
+    const size_t stride = size_t(width) * channels;
+    const size_t slices_nb = header.slices();
+    const size_t planes = header.planar ? channels : 1;
+
+    std::vector<std::vector<uint8_t>> slices(slices_nb * planes);
+    PartStats part_stats(stats, slices.size());
+    pool.parallel_for(slices.size(), [&](size_t i) {
+        const Rect r = header.slice(i / planes);
+        const Sample* pixels = rgb + r.y * stride + size_t(r.x) * channels;
+        auto& buffer = slices[i];
+        buffer.reserve(size_t(r.width) * r.height * channels * sizeof(Sample) / planes / 2);
+        auto put = [&buffer](uint8_t x) {
+            buffer.push_back(x);
+        };
+        if (header.planar) {
+            encodePlane(pixels, stride, r.width, r.height, int(i % planes), header, put, carry ? carry + i : nullptr, part_stats[i], r.y);
+        } else {
+            size_t row_start = 0;
+            encodeSlice(pixels, stride, r.width, r.height, header, put, [&](int y) {
+                if (header.wavefront_sync) header.row_sizes[y] = uint32_t(buffer.size() - row_start);
+                row_start = buffer.size();
+            }, carry ? carry + i : nullptr, part_stats[i], r.y);
+        }
+    });
+    part_stats.finish();
+
+    header.index.clear();
+    uint64_t offset = 0;
+    for (size_t i = 0; i < slices.size(); ++i) {
+        if (i % planes == 0) {
+            header.index.push_back(offset);
+        } else {
+            header.plane_sizes[i / planes * (planes - 1) + i % planes - 1] = slices[i - 1].size();
+        }
+        offset += slices[i].size();
+    }
+
+    std::vector<uint8_t> buffer;
+    buffer.reserve(header.size() + offset);
+    header.write([&](uint8_t x) {
+        buffer.push_back(x);
+    });
+    for (auto& slice : slices) {
+        buffer.insert(buffer.end(), slice.begin(), slice.end());
+    }
+    recordStats(stats, [&](CodecStats& s) {
+        s.raw_bytes += stride * header.height * sizeof(Sample);
+        s.coded_bytes += buffer.size();
+    });
+    return buffer;
+}
+
+inline std::vector<uint8_t> compressImage(const std::vector<uint8_t>& rgb, int width, int height, int channels, const EncodeOptions& options = {}) {
+    Header header;
+    initHeader(header, rgb.size(), width, height, channels, options);
+    checkSamples(rgb.data(), rgb.size(), options);
+    return encodeStream(rgb.data(), header, options.pool ? *options.pool : ThreadPool::shared(), nullptr, options.stats);
+}
+
+/**
+ * @brief Same for samples of 9 to 16 bits, with `options.bit_depth` set to their depth.
+ */
+inline std::vector<uint8_t> compressImage(const std::vector<uint16_t>& rgb, int width, int height, int channels, const EncodeOptions& options) {
+    Header header;
+    initHeader(header, rgb.size(), width, height, channels, options);
+    checkSamples(rgb.data(), rgb.size(), options);
+    return encodeStream(rgb.data(), header, options.pool ? *options.pool : ThreadPool::shared(), nullptr, options.stats);
+}
+
+struct RawImage {
+    std::vector<uint8_t> pixels; // native-endian uint16_t samples when bit_depth is above 8
+    uint32_t width;
+    uint32_t height;
+    uint8_t channels;
+    uint8_t bit_depth = 8;
+};
+
+/**
+ * @brief Parses the header of a stream, e.g. to size the output of decompressInto().
+ */
+inline Header readHeader(const uint8_t* data, size_t size) {
+    size_t pos = 0;
+    return Header::read([&]() -> uint8_t {
+        if (pos >= size)
+            throw std::runtime_error("Truncated header");
+        return data[pos++];
+    });
+}
+
+/**
+ * @brief Frames that continue the states of a sequence only decode through SequenceDecoder.
+ */
+inline void requireStandalone(const Header& header) {
+    if (header.carried_states) {
+        throw std::runtime_error("Frame depends on the previous frame of its sequence");
+    }
+}
+
+/**
+ * @brief Samples above 8 bits only decode through decompressInto() and decompressImage().
+ */
+inline void requireByteSamples(const Header& header) {
+    if (header.bit_depth != 8) {
+        throw std::runtime_error("Samples above 8 bits need decompressInto()");
+    }
+}
+
+/**
+ * @brief Decodes the slices of a stream whose header was parsed into `header`.
+ *
+ * With fewer slices than threads, the entropy stage of every 8-bit slice runs as one task
+ * and its output stage as another, see RowPipeline; not while collecting `stats`, so that
+ * every row is timed whole.
+ *
+ * @param carry See encodeStream().
+ */
+inline void decodeStream(const uint8_t* data, size_t size, const OutputLayout& out, const Header& header, ThreadPool& workers,
+                         ContextStates* carry = nullptr, CodecStats* stats = nullptr) {
+    const uint8_t channels = header.channels;
+    const size_t slices_nb = header.slices();
+    const bool deep = header.bit_depth > 8;
+    const size_t sample_size = deep ? 2 : 1;
+    // first sample of pixel (x, y) in the output
+    auto at = [&](int x, int y) {
+        return out.pixels + y * out.row_stride + size_t(x) * (out.plane_stride ? 1 : channels) * sample_size;
+    };
+    std::vector<size_t> offsets;
+    sliceOffsets(header, header.size(), size, offsets);
+    recordStats(stats, [&](CodecStats& s) {
+        s.raw_bytes += size_t(header.width) * channels * header.height * sample_size;
+        s.coded_bytes += size;
+    });
+
+    if (header.wavefront_sync) {
+        decodeWavefront(data + offsets[0], offsets[1] - offsets[0], out, header, workers, stats);
+        return;
+    }
+    // every plane of every slice on its own, then the pixels are put back together
+    auto decodePlanes = [&](auto line) {
+        using Line = decltype(line);
+        const size_t plane_size = size_t(header.width) * header.height;
+        std::vector<Line> planes(plane_size * channels);
+        PartStats part_stats(stats, slices_nb * channels);
+        workers.parallel_for(slices_nb * channels, [&](size_t j) {
+            const size_t i = j / channels;
+            const size_t p = j % channels;
+            const Rect r = header.slice(i);
+            std::vector<size_t> parts;
+            planeOffsets(header, i, offsets[i], offsets[i + 1], parts);
+            decodePlane(data + parts[p], parts[p + 1] - parts[p], planes.data() + p * plane_size + size_t(r.y) * header.width + r.x,
+                        header.width, r.width, r.height, header, carry ? carry + j : nullptr, part_stats[j], r.y, int(p));
+        });
+        workers.parallel_for(slices_nb, [&](size_t i) {
+            const Rect r = header.slice(i);
+            for (int y = r.y; y < r.y + r.height; ++y) {
+                const uint64_t start = statsClock();
+                const Line* row = planes.data() + size_t(y) * header.width + r.x;
+                if constexpr (std::is_same_v<Line, int32_t>) {
+                    combinePlaneRow(row, plane_size, r.width, channels, reinterpret_cast<uint16_t*>(at(r.x, y)), out.plane_stride / 2,
+                                    (1 << header.bit_depth) - 1);
+                } else {
+                    combinePlaneRow(row, plane_size, r.width, channels, at(r.x, y), out.plane_stride);
+                }
+                recordStats(part_stats[i * channels], [&](CodecStats& s) {
+                    const uint64_t ns = statsClock() - start;
+                    s.phase(CodecStats::Output, ns);
+                    s.row(y, ns);
+                });
+            }
+        });
+        part_stats.finish();
+    };
+    if (header.planar) {
+        if (deep) {
+            decodePlanes(int32_t{});
+        } else {
+            decodePlanes(int16_t{});
+        }
+        return;
+    }
+    PartStats part_stats(stats, slices_nb);
+    if (slices_nb < workers.size() && !part_stats.target && !deep) {
+        // tasks are taken in order, so the output stage of a slice never starts before its
+        // entropy stage
+        std::vector<std::unique_ptr<RowPipeline>> pipelines;
+        for (size_t i = 0; i < slices_nb; ++i) {
+            pipelines.push_back(std::make_unique<RowPipeline>(header.slice(i).width, channels));
+        }
+        workers.parallel_for(2 * slices_nb, [&](size_t j) {
+            const size_t i = j / 2;
+            const Rect r = header.slice(i);
+            if (j % 2 == 0) {
+                decodeSlice(data + offsets[i], offsets[i + 1] - offsets[i], at(r.x, r.y), out.row_stride, out.plane_stride, r.width,
+                            r.height, header, carry ? carry + i : nullptr, pipelines[i].get());
+            } else {
+                writeSliceRows(*pipelines[i], at(r.x, r.y), out.row_stride, out.plane_stride, r.width, r.height, channels);
+            }
+        });
+        return;
+    }
+    workers.parallel_for(slices_nb, [&](size_t i) {
+        const Rect r = header.slice(i);
+        decodeSlice(data + offsets[i], offsets[i + 1] - offsets[i], at(r.x, r.y), out.row_stride, out.plane_stride, r.width, r.height,
+                    header, carry ? carry + i : nullptr, nullptr, part_stats[i], r.y);
+    });
+    part_stats.finish();
+}
+
+/**
+ * @brief Checks that `out` holds `width` x `height` pixels of the samples of `header`.
+ */
+inline void checkOutput(const OutputLayout& out, const Header& header, uint32_t width, uint32_t height) {
+    const size_t sample_size = header.bit_depth > 8 ? 2 : 1;
+    const size_t row = (out.plane_stride ? width : size_t(width) * header.channels) * sample_size;
+    if (out.row_stride < row || (out.plane_stride && out.plane_stride < width * sample_size)) {
+        throw std::invalid_argument("Output rows overlap");
+    }
+    if (sample_size == 2 && (reinterpret_cast<uintptr_t>(out.pixels) | out.row_stride | out.plane_stride) % 2) {
+        throw std::invalid_argument("Output of 16-bit samples is not 2-byte aligned");
+    }
+    const size_t last = out.plane_stride ? (header.channels - 1) * out.plane_stride + row : row;
+    if (height && out.capacity < (height - 1) * out.row_stride + last) {
+        throw std::invalid_argument("Output buffer is smaller than the image");
+    }
+}
+
+/**
+ * @brief Decompresses into memory owned by the caller, in any OutputLayout.
+ * @return The header of the stream.
+ */
+inline Header decompressInto(const uint8_t* data, size_t size, const OutputLayout& out, ThreadPool* pool = nullptr,
+                             CodecStats* stats = nullptr) {
+    const Header header = readHeader(data, size);
+    requireStandalone(header);
+    checkOutput(out, header, header.width, header.height);
+    decodeStream(data, size, out, header, pool ? *pool : ThreadPool::shared(), nullptr, stats);
+    return header;
+}
+
+/**
+ * @brief Decompresses into memory owned by the caller, as tightly packed interleaved rows.
+ *
+ * @param capacity Size of `pixels` in bytes; must hold `width * height * channels` samples,
+ *                 of two bytes above 8 bits.
+ * @return The header of the stream.
+ */
+inline Header decompressInto(const uint8_t* data, size_t size, uint8_t* pixels, size_t capacity, ThreadPool* pool = nullptr,
+                             CodecStats* stats = nullptr) {
+    const Header header = readHeader(data, size);
+    const size_t row = size_t(header.width) * header.channels * (header.bit_depth > 8 ? 2 : 1);
+    return decompressInto(data, size, OutputLayout{pixels, capacity, row, 0}, pool, stats);
+}
+
+inline RawImage decompressImage(const std::vector<uint8_t>& data, ThreadPool* pool = nullptr, CodecStats* stats = nullptr) {
+    const Header header = readHeader(data.data(), data.size());
+    const size_t sample_size = header.bit_depth > 8 ? 2 : 1;
+    RawImage image{std::vector<uint8_t>(size_t(header.width) * header.channels * header.height * sample_size), header.width, header.height,
+                   header.channels, header.bit_depth};
+    decompressInto(data.data(), data.size(), image.pixels.data(), image.pixels.size(), pool, stats);
+    return image;
+}
+
+/**
+ * @brief Box sums of the pixels one slice adds to a downscaled region.
+ *
+ * Every slice sums its own part, so slices decode in parallel without sharing output
+ * pixels; the parts are added up once all of them are done.
+ */
+struct BoxSums {
+    int x = 0; // first output pixel covered
+    int y = 0;
+    int cols = 0;
+    int rows = 0;
+    std::vector<uint64_t> sums; // cols * rows pixels of interleaved samples
+};
+
+/**
+ * @brief Copies `count` pixels of interleaved samples to a row laid out as OutputLayout,
+ *        with `plane_stride` in samples.
+ */
+template <typename Sample>
+inline void copyPixels(const Sample* pixels, int count, int channels, Sample* out, size_t plane_stride) {
+    if (plane_stride == 0) {
+        std::copy_n(pixels, size_t(count) * channels, out);
+        return;
+    }
+    for (int w = 0; w < count; ++w) {
+        for (int i = 0; i < channels; ++i) out[i * plane_stride + w] = pixels[w * channels + i];
+    }
+}
+
+/**
+ * @brief Decodes the slices of a stream overlapping `region`, see decompressRegion().
+ *
+ * @param Sample `uint8_t`, or `uint16_t` for a header above 8 bits.
+ */
+template <typename Sample>
+inline void decodeRegion(const uint8_t* data, size_t size, const Header& header, const Rect& region, int scale,
+                         const OutputLayout& out, ThreadPool& workers, CodecStats* stats) {
+    using Line = LineSample<Sample>;
+    const int channels = header.channels;
+    const int maxval = (1 << header.bit_depth) - 1;
+    const int x_end = region.x + region.width;
+    const int y_end = region.y + region.height;
+    const int width = int((int64_t(region.width) + scale - 1) / scale);
+    const int height = int((int64_t(region.height) + scale - 1) / scale);
+    const size_t plane_stride = out.plane_stride / sizeof(Sample);
+    std::vector<size_t> offsets;
+    sliceOffsets(header, header.size(), size, offsets);
+    // part of slice `r` inside the region
+    auto crop = [&](const Rect& r) {
+        const int x = std::max(r.x, region.x);
+        const int y = std::max(r.y, region.y);
+        return Rect{x, y, std::min(r.x + r.width, x_end) - x, std::min(r.y + r.height, y_end) - y};
+    };
+
+    // only the slices overlapping the region are decoded, each down to its last row
+    std::vector<size_t> slices;
+    for (size_t i = 0; i < header.slices(); ++i) {
+        const Rect r = header.slice(i);
+        if (r.x < x_end && r.x + r.width > region.x && r.y < y_end && r.y + r.height > region.y) slices.push_back(i);
+    }
+    recordStats(stats, [&](CodecStats& s) {
+        s.raw_bytes += size_t(width) * height * channels * sizeof(Sample);
+        for (const size_t i : slices) s.coded_bytes += offsets[i + 1] - offsets[i];
+    });
+    std::vector<BoxSums> boxes(scale > 1 ? slices.size() : 0);
+    for (size_t k = 0; k < boxes.size(); ++k) {
+        const Rect c = crop(header.slice(slices[k]));
+        BoxSums& box = boxes[k];
+        box.x = (c.x - region.x) / scale;
+        box.y = (c.y - region.y) / scale;
+        box.cols = (c.x + c.width - 1 - region.x) / scale + 1 - box.x;
+        box.rows = (c.y + c.height - 1 - region.y) / scale + 1 - box.y;
+        box.sums.assign(size_t(box.cols) * box.rows * channels, 0);
+    }
+
+    // pixels [x, x + count) of image row `y`, from the k-th slice: `write` stores them at a
+    // row laid out with a plane stride in samples, straight into the output or, when
+    // downscaling, into `pixels` and from there into the box sums of the slice
+    auto put = [&](size_t k, int x, int y, int count, std::vector<Sample>& pixels, auto&& write) {
+        if (scale == 1) {
+            Sample* row = reinterpret_cast<Sample*>(out.pixels + size_t(y - region.y) * out.row_stride);
+            write(row + size_t(x - region.x) * (plane_stride ? 1 : channels), plane_stride);
+            return;
+        }
+        pixels.resize(size_t(count) * channels);
+        write(pixels.data(), size_t(0));
+        BoxSums& box = boxes[k];
+        uint64_t* sums = box.sums.data() + size_t((y - region.y) / scale - box.y) * box.cols * channels;
+        for (int w = 0; w < count; ++w) {
+            uint64_t* sum = sums + size_t((x + w - region.x) / scale - box.x) * channels;
+            for (int i = 0; i < channels; ++i) sum[i] += pixels[size_t(w) * channels + i];
+        }
+    };
+
+    if (header.wavefront_sync) {
+        // a row starts from the states of the row above, so every row down to the region
+        // is decoded, into a band
+        Header band = header;
+        band.height = uint32_t(y_end);
+        band.row_sizes.resize(y_end);
+        const size_t stride = size_t(header.width) * channels;
+        std::vector<Sample> rows(stride * y_end);
+        decodeWavefront(data + offsets[0], offsets[1] - offsets[0],
+                        OutputLayout{reinterpret_cast<uint8_t*>(rows.data()), rows.size() * sizeof(Sample), stride * sizeof(Sample), 0},
+                        band, workers, stats);
+        std::vector<Sample> pixels;
+        for (int y = region.y; y < y_end; ++y) {
+            put(0, region.x, y, region.width, pixels, [&](Sample* row, size_t row_plane_stride) {
+                copyPixels(rows.data() + y * stride + size_t(region.x) * channels, region.width, channels, row, row_plane_stride);
+            });
+        }
+    } else if (header.planar) {
+        // the planes of every slice down to the region, then its pixels are put back together
+        std::vector<std::vector<Line>> planes(slices.size());
+        for (size_t k = 0; k < slices.size(); ++k) {
+            const Rect r = header.slice(slices[k]);
+            const Rect c = crop(r);
+            planes[k].resize(size_t(r.width) * (c.y + c.height - r.y) * channels);
+        }
+        PartStats part_stats(stats, slices.size() * channels);
+        workers.parallel_for(slices.size() * channels, [&](size_t j) {
+            const size_t k = j / channels;
+            const size_t p = j % channels;
+            const size_t i = slices[k];
+            const Rect r = header.slice(i);
+            const size_t plane_size = planes[k].size() / channels;
+            std::vector<size_t> parts;
+            planeOffsets(header, i, offsets[i], offsets[i + 1], parts);
+            decodePlane(data + parts[p], parts[p + 1] - parts[p], planes[k].data() + p * plane_size, r.width, r.width,
+                        int(plane_size / r.width), header, nullptr, part_stats[j], r.y, int(p));
+        });
+        workers.parallel_for(slices.size(), [&](size_t k) {
+            const Rect r = header.slice(slices[k]);
+            const Rect c = crop(r);
+            const size_t plane_size = planes[k].size() / channels;
+            std::vector<Sample> pixels;
+            for (int y = c.y; y < c.y + c.height; ++y) {
+                const Line* line = planes[k].data() + size_t(y - r.y) * r.width + (c.x - r.x);
+                put(k, c.x, y, c.width, pixels, [&](Sample* row, size_t row_plane_stride) {
+                    if constexpr (std::is_same_v<Line, int32_t>) {
+                        combinePlaneRow(line, plane_size, c.width, channels, row, row_plane_stride, maxval);
+                    } else {
+                        combinePlaneRow(line, plane_size, c.width, channels, row, row_plane_stride);
+                    }
+                });
+            }
+        });
+        part_stats.finish();
+    } else {
+        PartStats part_stats(stats, slices.size());
+        workers.parallel_for(slices.size(), [&](size_t k) {
+            const size_t i = slices[k];
+            const Rect r = header.slice(i);
+            const Rect c = crop(r);
+            SliceDecoder slice(r.width, header, ByteReader{data + offsets[i], data + offsets[i + 1]});
+            slice.collect(part_stats[k], r.y);
+            std::vector<Sample> pixels;
+            for (int y = r.y; y < c.y + c.height; ++y) {
+                slice.decodeLine();
+                if (y < c.y) continue;
+                put(k, c.x, y, c.width, pixels, [&](Sample* row, size_t row_plane_stride) {
+                    slice.writePixels(c.x - r.x, c.width, reinterpret_cast<uint8_t*>(row), row_plane_stride * sizeof(Sample));
+                });
+            }
+            slice.finish();
+        });
+        part_stats.finish();
+    }
+    if (scale == 1) return;
+
+    // every output pixel is the rounded mean of its block, clipped to the region
+    std::vector<uint64_t> sums(size_t(width) * height * channels);
+    for (const BoxSums& box : boxes) {
+        for (int y = 0; y < box.rows; ++y) {
+            const uint64_t* part = box.sums.data() + size_t(y) * box.cols * channels;
+            uint64_t* sum = sums.data() + (size_t(box.y + y) * width + box.x) * channels;
+            for (size_t n = 0; n < size_t(box.cols) * channels; ++n) sum[n] += part[n];
+        }
+    }
+    for (int y = 0; y < height; ++y) {
+        Sample* row = reinterpret_cast<Sample*>(out.pixels + y * out.row_stride);
+        const uint64_t block_rows = std::min(scale, region.height - y * scale);
+        for (int x = 0; x < width; ++x) {
+            const uint64_t n = block_rows * std::min(scale, region.width - x * scale);
+            const uint64_t* sum = sums.data() + (size_t(y) * width + x) * channels;
+            for (int i = 0; i < channels; ++i) {
+                row[plane_stride ? i * plane_stride + x : size_t(x) * channels + i] = Sample((sum[i] + n / 2) / n);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Checks that `region` lies inside the image of `header` and `scale` is at least 1.
+ */
+inline void checkRegion(const Header& header, const Rect& region, int scale) {
+    if (region.x < 0 || region.y < 0 || region.width < 1 || region.height < 1 || uint32_t(region.x) >= header.width ||
+        uint32_t(region.y) >= header.height || uint32_t(region.width) > header.width - region.x ||
+        uint32_t(region.height) > header.height - region.y) {
+        throw std::invalid_argument("Region is outside the image");
+    }
+    if (scale < 1) {
+        throw std::invalid_argument("Invalid downscale factor");
+    }
+}
+
+/**
+ * @brief Decodes the pixels of `region` only, e.g. a crop of a large scan, optionally
+ *        box-downscaled by `scale` for a thumbnail.
+ *
+ * Only the slices overlapping the region are decoded, each down to the last row of the
+ * region, so the time taken follows the area of those slices rather than of the image;
+ * streams with more slices crop closer. Their rows above the region are decoded too, as
+ * they predict the rows below. A wavefront stream decodes every row down to the region
+ * into a band, in parallel. With a `scale` above 1, an output pixel is the rounded mean of
+ * a `scale` x `scale` block of the region, clipped at its right and bottom edges.
+ *
+ * @param out Receives ceil(region.width / scale) x ceil(region.height / scale) pixels.
+ * @return The header of the stream.
+ */
+inline Header decompressRegion(const uint8_t* data, size_t size, const Rect& region, const OutputLayout& out, int scale = 1,
+                               ThreadPool* pool = nullptr, CodecStats* stats = nullptr) {
+    const Header header = readHeader(data, size);
+    requireStandalone(header);
+    checkRegion(header, region, scale);
+    checkOutput(out, header, uint32_t((int64_t(region.width) + scale - 1) / scale),
+                uint32_t((int64_t(region.height) + scale - 1) / scale));
+    ThreadPool& workers = pool ? *pool : ThreadPool::shared();
+    if (header.bit_depth > 8) {
+        decodeRegion<uint16_t>(data, size, header, region, scale, out, workers, stats);
+    } else {
+        decodeRegion<uint8_t>(data, size, header, region, scale, out, workers, stats);
+    }
+    return header;
+}
+
+/**
+ * @brief decompressRegion() into a RawImage of tightly packed interleaved rows.
+ */
+inline RawImage decompressRegion(const std::vector<uint8_t>& data, const Rect& region, int scale = 1, ThreadPool* pool = nullptr,
+                                 CodecStats* stats = nullptr) {
+    const Header header = readHeader(data.data(), data.size());
+    checkRegion(header, region, scale);
+    const size_t sample_size = header.bit_depth > 8 ? 2 : 1;
+    const uint32_t width = uint32_t((int64_t(region.width) + scale - 1) / scale);
+    const uint32_t height = uint32_t((int64_t(region.height) + scale - 1) / scale);
+    RawImage image{std::vector<uint8_t>(size_t(width) * header.channels * height * sample_size), width, height, header.channels,
+                   header.bit_depth};
+    decompressRegion(data.data(), data.size(), region, OutputLayout{image.pixels.data(), image.pixels.size(), width * header.channels * sample_size, 0},
+                     scale, pool, stats);
+    return image;
+}
+
+/**
+ * @brief Smallest downscale factor fitting a `width` x `height` image into `size` x `size`
+ *        pixels, e.g. for a thumbnail through decompressRegion().
+ */
+inline int thumbnailScale(uint32_t width, uint32_t height, uint32_t size) {
+    const uint32_t longest = std::max(width, height);
+    return size ? int(std::max<uint32_t>(1, (longest + size - 1) / size)) : 1;
+}
+
+/**
+ * @brief Reusable buffers for coding many images in a row, e.g. in a server.
+ *
+ * compressImage() and decompressImage() allocate line buffers, state tables and output for
+ * every call. A context keeps them and writes into the caller's vectors, so once those
+ * have grown to the largest image seen, compress() and decompress() do not touch the heap.
+ * Slices are coded one after the other on the calling thread: use one context per thread
+ * to code several images at once. A context codes 8-bit samples only.
+ */
+class CodecContext {
+public:
+    CodecContext() = default;
+    CodecContext(const CodecContext&) = delete;
+    CodecContext& operator=(const CodecContext&) = delete;
+
+    /**
+     * @brief Same stream as compressImage(); `out` is overwritten but keeps its capacity.
+     *        The pool of the options is ignored.
+     */
+    void compress(const std::vector<uint8_t>& rgb, int width, int height, int channels, std::vector<uint8_t>& out,
+                  const EncodeOptions& options = {}) {
+        initHeader(header, rgb.size(), width, height, channels, options);
+        checkSamples(rgb.data(), rgb.size(), options);
+        out.resize(streamBound(header));
+        out.resize(encodeSlices(rgb.data(), out.data(), options.stats));
+    }
+
+    /**
+     * @brief Same stream as compressInto(), coded on the calling thread.
+     */
+    size_t compressInto(const uint8_t* pixels, int width, int height, int channels, uint8_t* out, size_t capacity,
+                        const EncodeOptions& options = {}) {
+        initHeader(header, size_t(width) * channels * height, width, height, channels, options);
+        checkSamples(pixels, size_t(width) * channels * height, options);
+        if (capacity < streamBound(header)) {
+            throw std::invalid_argument("Output buffer is smaller than compressBound()");
+        }
+        return encodeSlices(pixels, out, options.stats);
+    }
+
+    /**
+     * @brief Same as decompressImage(); the pixels of `image` keep their capacity.
+     */
+    void decompress(const std::vector<uint8_t>& data, RawImage& image, CodecStats* stats = nullptr) {
+        parseHeader(data.data(), data.size());
+        image.width = header.width;
+        image.height = header.height;
+        image.channels = header.channels;
+        image.bit_depth = header.bit_depth;
+        image.pixels.resize(size_t(header.width) * header.channels * header.height);
+        decodeSlices(data.data(), data.size(), image.pixels.data(), stats);
+    }
+
+    /**
+     * @brief Same as llcomp::decompressInto(), decoded on the calling thread.
+     * @return The header of the stream, valid until the next call.
+     */
+    const Header& decompressInto(const uint8_t* data, size_t size, uint8_t* pixels, size_t capacity, CodecStats* stats = nullptr) {
+        parseHeader(data, size);
+        if (capacity < size_t(header.width) * header.channels * header.height) {
+            throw std::invalid_argument("Output buffer is smaller than the image");
+        }
+        decodeSlices(data, size, pixels, stats);
+        return header;
+    }
+
+private:
+    struct OutputWriter {
+        CodecContext* self;
+        void operator()(uint8_t x) const {
+            *self->cursor++ = x;
+        }
+    };
+
+    /// Codes the slices one after the other behind the header; `out` holds streamBound().
+    size_t encodeSlices(const uint8_t* rgb, uint8_t* out, CodecStats* stats) {
+        const uint64_t start = statsClock();
+        const int channels = header.channels;
+        const size_t stride = size_t(header.width) * channels;
+        const size_t slices_nb = header.slices();
+        const size_t header_size = header.size();
+        cursor = out + header_size;
+        for (size_t i = 0; i < slices_nb; ++i) {
+            const Rect r = header.slice(i);
+            header.index[i] = cursor - out - header_size;
+            const uint8_t* pixels = rgb + r.y * stride + size_t(r.x) * channels;
+            if (header.planar) {
+                plane_row.resize(r.width);
+                for (int p = 0; p < channels; ++p) {
+                    const uint8_t* plane_start = cursor;
+                    resetEncoder(r.width);
+                    encoder->collect(stats, r.y, p);
+                    for (int h = 0; h < r.height; ++h) {
+                        transformPlaneRow(pixels + h * stride, r.width, channels, p, plane_row.data());
+                        encoder->encodePlaneRow(plane_row.data());
+                    }
+                    encoder->finish();
+                    if (p + 1 < channels) header.plane_sizes[i * (channels - 1) + p] = cursor - plane_start;
+                }
+                continue;
+            }
+            resetEncoder(r.width);
+            encoder->collect(stats, r.y);
+            for (int h = 0; h < r.height; ++h) {
+                const uint8_t* row_start = cursor;
+                encoder->encodeRow(pixels + h * stride);
+                if (header.wavefront_sync) header.row_sizes[h] = uint32_t(cursor - row_start);
+            }
+            encoder->finish();
+        }
+        uint8_t* p = out;
+        header.write([&p](uint8_t x) {
+            *p++ = x;
+        });
+        recordStats(stats, [&](CodecStats& s) {
+            s.raw_bytes += stride * header.height;
+            s.coded_bytes += cursor - out;
+            s.wall_ns += statsClock() - start;
+        });
+        return cursor - out;
+    }
+
+    void resetEncoder(int width) {
+        if (encoder) {
+            encoder->reset(width, header);
+        } else {
+            encoder.emplace(width, header, OutputWriter{this});
+        }
+    }
+
+    void resetDecoder(int width, const ByteReader& reader) {
+        if (decoder) {
+            decoder->reset(width, header, reader);
+        } else {
+            decoder.emplace(width, header, reader);
+        }
+    }
+
+    void parseHeader(const uint8_t* data, size_t size) {
+        size_t pos = 0;
+        header.parse([&]() -> uint8_t {
+            if (pos >= size)
+                throw std::runtime_error("Truncated header");
+            return data[pos++];
+        });
+        requireStandalone(header);
+        requireByteSamples(header);
+    }
+
+    void decodeSlices(const uint8_t* data, size_t size, uint8_t* pixels, CodecStats* stats) {
+        const uint64_t start = statsClock();
+        const int channels = header.channels;
+        const size_t stride = size_t(header.width) * channels;
+        sliceOffsets(header, header.size(), size, offsets);
+        for (size_t i = 0; i < header.slices(); ++i) {
+            const Rect r = header.slice(i);
+            uint8_t* p = pixels + r.y * stride + size_t(r.x) * channels;
+            if (header.planar) {
+                // the planes of the slice are decoded whole, then interleaved
+                const size_t plane_size = size_t(r.width) * r.height;
+                planes.resize(plane_size * channels);
+                planeOffsets(header, i, offsets[i], offsets[i + 1], part_offsets);
+                for (int c = 0; c < channels; ++c) {
+                    resetDecoder(r.width, ByteReader{data + part_offsets[c], data + part_offsets[c + 1]});
+                    decoder->collect(stats, r.y, c);
+                    for (int h = 0; h < r.height; ++h) {
+                        decoder->decodePlaneRow(planes.data() + c * plane_size + size_t(h) * r.width);
+                    }
+                    decoder->finish();
+                }
+                for (int h = 0; h < r.height; ++h) {
+                    const uint64_t row_start = statsClock();
+                    combinePlaneRow(planes.data() + size_t(h) * r.width, plane_size, r.width, channels, p + h * stride);
+                    recordStats(stats, [&](CodecStats& s) {
+                        const uint64_t ns = statsClock() - row_start;
+                        s.phase(CodecStats::Output, ns);
+                        s.row(r.y + h, ns);
+                    });
+                }
+                continue;
+            }
+            resetDecoder(r.width, ByteReader{data + offsets[i], data + offsets[i + 1]});
+            decoder->collect(stats, r.y);
+            if (header.wavefront_sync) {
+                rowOffsets(header, offsets[i], offsets[i + 1], part_offsets);
+                for (int h = 0; h < r.height; ++h) {
+                    decoder->decodeSubstream(h, p + h * stride, ByteReader{data + part_offsets[h], data + part_offsets[h + 1]});
+                }
+            } else {
+                for (int h = 0; h < r.height; ++h) {
+                    decoder->decodeRow(p + h * stride);
+                }
+            }
+            decoder->finish();
+        }
+        recordStats(stats, [&](CodecStats& s) {
+            s.raw_bytes += stride * header.height;
+            s.coded_bytes += size;
+            s.wall_ns += statsClock() - start;
+        });
+    }
+
+    Header header;
+    std::vector<size_t> offsets;
+    /// rows of a wavefront slice or planes of a planar slice
+    std::vector<size_t> part_offsets;
+    std::vector<int16_t> plane_row;
+    std::vector<int16_t> planes;
+    uint8_t* cursor = nullptr;
+    std::optional<SliceEncoder<OutputWriter>> encoder;
+    std::optional<SliceDecoder<ByteReader>> decoder;
+};
+
+/**
+ * @brief Streaming encoder: rows go in one at a time, compressed bytes go out to a sink.
+ *
+ * Only three lines, the state table and a small output chunk are held, so memory does not
+ * depend on the image height. The stream is a single slice without an index, which lets
+ * the sink be a plain forward-only file; the slice grid, wavefront rows, planar slices and
+ * pool of the options are ignored. Samples are 8-bit.
+ */
+class Encoder {
+public:
+    using Sink = std::function<void(const uint8_t* data, size_t size)>;
+    static constexpr size_t chunk_size = 64 * 1024;
+
+    Encoder(int width, int height, int channels, Sink sink, const EncodeOptions& options = {})
+        : width_(width), height_(height), channels_(channels), sink(std::move(sink)),
+          header(streamHeader(width, height, channels, options)), slice(width, header, ChunkWriter{this}) {
+        header.write(ChunkWriter{this});
+    }
+
+    Encoder(const Encoder&) = delete;
+    Encoder& operator=(const Encoder&) = delete;
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int channels() const { return channels_; }
+    int rowsWritten() const { return row; }
+
+    /**
+     * @brief Codes the next row of `width * channels` interleaved samples.
+     */
+    void writeRow(const uint8_t* pixels) {
+        if (row >= height_) {
+            throw std::logic_error("All rows were already written");
+        }
+        slice.encodeRow(pixels);
+        ++row;
+    }
+
+    /**
+     * @brief Flushes the coder and the pending output; every row must have been written.
+     */
+    void finish() {
+        if (row != height_) {
+            throw std::logic_error("Not all rows were written");
+        }
+        slice.finish();
+        flush();
+    }
+
+private:
+    /// A single slice without index: it runs to the end of the stream. Checks the arguments
+    /// before `slice` sizes its lines from them.
+    static Header streamHeader(int width, int height, int channels, const EncodeOptions& options) {
+        if (width < 0 || height < 0 || channels < 1 || channels > 4 || int64_t(width) * channels > 0x7FFFFFFF) {
+            throw std::invalid_argument("Unsupported image dimensions");
+        }
+        if (options.bit_depth != 8) {
+            throw std::invalid_argument("Sample type does not match the bit depth");
+        }
+        Header header;
+        header.width = width;
+        header.height = height;
+        header.channels = channels;
+        header.model = options.model.value_or(pickModel(uint64_t(width) * height * channels));
+        header.coder = options.coder;
+        header.run_mode = options.run_mode;
+        header.adaptive_predictor = options.adaptive_predictor;
+        header.metadata = options.metadata;
+        initStates(header, options);
+        return header;
+    }
+
+    struct ChunkWriter {
+        Encoder* self;
+        void operator()(uint8_t x) const {
+            self->chunk[self->chunk_len++] = x;
+            if (self->chunk_len == chunk_size) self->flush();
+        }
+    };
+
+    void flush() {
+        if (chunk_len) sink(chunk.data(), chunk_len);
+        chunk_len = 0;
+    }
+
+    int width_;
+    int height_;
+    int channels_;
+    int row{0};
+    Sink sink;
+    std::vector<uint8_t> chunk = std::vector<uint8_t>(chunk_size);
+    size_t chunk_len{0};
+    Header header;
+    SliceEncoder<ChunkWriter> slice;
+};
+
+/**
+ * @brief Streaming decoder: compressed bytes are pulled from a source, rows come out.
+ *
+ * Streams with a single column of slices (revision 2, the streaming Encoder, horizontal
+ * slices) are decoded straight from the source with O(width) memory. For grids with
+ * several columns and for planar streams, the compressed bytes of the current slice row
+ * are buffered.
+ */
+class Decoder {
+public:
+    /// Reads up to `size` bytes into `data` and returns the count; 0 means end of stream.
+    using Source = std::function<size_t(uint8_t* data, size_t size)>;
+    static constexpr size_t chunk_size = 64 * 1024;
+    static constexpr uint64_t unbounded = ~uint64_t{0};
+
+    explicit Decoder(Source source) : source(std::move(source)) {
+        header_ = Header::read([this] { return readU8(); });
+        requireStandalone(header_);
+        requireByteSamples(header_);
+        width_ = header_.width;
+        height_ = header_.height;
+        channels_ = header_.channels;
+        cols = header_.slice_cols;
+        rows = header_.slice_rows;
+        if (header_.planar) plane_row.resize(size_t(width_) * channels_);
+        for (size_t i = 0; i < header_.slices(); ++i) {
+            sizes.push_back(i + 1 < header_.index.size() ? header_.index[i + 1] - header_.index[i] : unbounded);
+        }
+    }
+
+    Decoder(const Decoder&) = delete;
+    Decoder& operator=(const Decoder&) = delete;
+
+    const Header& header() const { return header_; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int channels() const { return channels_; }
+    int rowsRead() const { return row; }
+
+    /**
+     * @brief Decodes the next row into `width * channels` interleaved samples.
+     * @return false once every row has been returned.
+     */
+    bool readRow(uint8_t* pixels) {
+        if (row >= height_) {
+            return false;
+        }
+        if (row == next_slice_row_y) {
+            startSliceRow();
+        }
+        if (header_.wavefront_sync) {
+            // the row substreams follow each other, sized by the header
+            skip(slice_left);
+            slice_left = header_.row_sizes[row];
+            slices[0].decodeSubstream(row, pixels, ByteReader{nullptr, nullptr, this});
+            ++row;
+            return true;
+        }
+        if (header_.planar) {
+            // one decoder per plane, the row of every plane is interleaved as it comes
+            for (int sx = 0; sx < cols; ++sx) {
+                const Rect r = sliceRect(width_, height_, cols, rows, sx, slice_row);
+                for (int c = 0; c < channels_; ++c) {
+                    slices[sx * channels_ + c].decodePlaneRow(plane_row.data() + c * r.width);
+                }
+                combinePlaneRow(plane_row.data(), r.width, r.width, channels_, pixels + r.x * channels_);
+            }
+            ++row;
+            return true;
+        }
+        for (int sx = 0; sx < cols; ++sx) {
+            const Rect r = sliceRect(width_, height_, cols, rows, sx, slice_row);
+            slices[sx].decodeRow(pixels + r.x * channels_);
+        }
+        ++row;
+        return true;
+    }
+
+private:
+    friend struct ByteReader;
+
+    void startSliceRow() {
+        slice_row = row == 0 ? 0 : slice_row + 1;
+        next_slice_row_y = sliceRect(width_, height_, cols, rows, 0, slice_row + 1).y;
+        slices.clear();
+        slices.reserve(header_.planar ? cols * channels_ : cols);
+        skip(slice_left);
+        if (cols == 1 && !header_.planar) {
+            slice_left = header_.wavefront_sync ? 0 : sizes[slice_row];
+            slices.emplace_back(width_, header_, ByteReader{nullptr, nullptr, this});
+            return;
+        }
+        uint64_t total = 0;
+        bool to_end = false;
+        for (int sx = 0; sx < cols; ++sx) {
+            const uint64_t size = sizes[slice_row * cols + sx];
+            to_end |= size == unbounded;
+            total += to_end ? 0 : size;
+        }
+        slice_data.clear();
+        while (to_end || slice_data.size() < total) {
+            if (chunk_pos == chunk_len && !fill()) {
+                if (to_end) break;
+                throw std::runtime_error("Truncated slice data");
+            }
+            const size_t n = to_end ? chunk_len - chunk_pos : std::min<uint64_t>(chunk_len - chunk_pos, total - slice_data.size());
+            slice_data.insert(slice_data.end(), chunk.data() + chunk_pos, chunk.data() + chunk_pos + n);
+            chunk_pos += n;
+        }
+        const uint8_t* p = slice_data.data();
+        const uint8_t* end = p + slice_data.size();
+        for (int sx = 0; sx < cols; ++sx) {
+            const uint64_t size = std::min<uint64_t>(sizes[slice_row * cols + sx], end - p);
+            const Rect r = sliceRect(width_, height_, cols, rows, sx, slice_row);
+            if (header_.planar) {
+                const size_t pos = p - slice_data.data();
+                planeOffsets(header_, size_t(slice_row) * cols + sx, pos, pos + size, plane_offsets);
+                for (int c = 0; c < channels_; ++c) {
+                    const uint8_t* plane = slice_data.data() + plane_offsets[c];
+                    slices.emplace_back(r.width, header_, ByteReader{plane, plane + (plane_offsets[c + 1] - plane_offsets[c]), nullptr});
+                }
+            } else {
+                slices.emplace_back(r.width, header_, ByteReader{p, p + size, nullptr});
+            }
+            p += size;
+        }
+    }
+
+    bool fill() {
+        if (eof) return false;
+        chunk_pos = 0;
+        chunk_len = source(chunk.data(), chunk.size());
+        eof = chunk_len == 0;
+        return !eof;
+    }
+
+    void skip(uint64_t n) {
+        while (n) {
+            if (chunk_pos == chunk_len && !fill()) return;
+            const size_t step = std::min<uint64_t>(n, chunk_len - chunk_pos);
+            chunk_pos += step;
+            n -= step;
+        }
+    }
+
+    /// Hands the next window of the current slice to a reader whose window ran out.
+    uint8_t refill(ByteReader& reader) {
+        if (slice_left == 0 || (chunk_pos == chunk_len && !fill())) {
+            reader.stream = nullptr;
+            return 0;
+        }
+        const size_t n = std::min<uint64_t>(chunk_len - chunk_pos, slice_left);
+        reader.cur = chunk.data() + chunk_pos;
+        reader.end = reader.cur + n;
+        chunk_pos += n;
+        if (slice_left != unbounded) slice_left -= n;
+        return *reader.cur++;
+    }
+
+    uint8_t readU8() {
+        if (chunk_pos == chunk_len && !fill()) {
+            throw std::runtime_error("Truncated header");
+        }
+        return chunk[chunk_pos++];
+    }
+
+    Source source;
+    std::vector<uint8_t> chunk = std::vector<uint8_t>(chunk_size);
+    size_t chunk_pos{0};
+    size_t chunk_len{0};
+    bool eof{false};
+    Header header_;
+    int width_{0};
+    int height_{0};
+    int channels_{0};
+    int cols{1};
+    int rows{1};
+    std::vector<uint64_t> sizes;
+    uint64_t slice_left{0};
+    int slice_row{0};
+    int next_slice_row_y{0};
+    int row{0};
+    std::vector<uint8_t> slice_data;
+    std::vector<size_t> plane_offsets;
+    std::vector<int16_t> plane_row;
+    std::vector<SliceDecoder<ByteReader>> slices;
+};
+
+inline uint8_t ByteReader::operator()() {
+    if (cur != end) return *cur++;
+    return stream ? stream->refill(*this) : 0;
+}
+
+/**
+ * @brief Byte source of IncrementalDecoder, reading a part of a stream that may still be
+ *        arriving.
+ *
+ * Past the end of its part, zeros are returned like ByteReader does. Past the bytes
+ * received so far, zeros are returned too and `starved` is set, so the row being decoded
+ * is rolled back until more bytes arrive.
+ */
+struct StreamReader {
+    const std::vector<uint8_t>* data = nullptr;
+    const size_t* end = nullptr; // end of the part, SIZE_MAX while unknown
+    size_t pos = 0;
+    bool* starved = nullptr;
+    size_t* read = nullptr; // end of the bytes read so far, kept outside the copies of a decoder
+
+    uint8_t operator()() {
+        if (pos < *end) {
+            if (pos < data->size()) {
+                *read = pos + 1;
+                return (*data)[pos++];
+            }
+            *starved = true;
+        }
+        return 0;
+    }
+
+    uint32_t read16() {
+        const uint32_t hi = (*this)();
+        return hi << 8 | (*this)();
+    }
+};
+
+/**
+ * @brief Incremental decoder: compressed bytes are pushed as they arrive, and every row
+ *        they complete is decoded right away.
+ *
+ * The Decoder pulls its bytes and blocks the caller until they come. This decoder is fed
+ * instead, e.g. from network callbacks: append() takes the next chunk, decode() decodes
+ * as many rows as the bytes received allow into the output and returns how many rows at
+ * the top of the image are complete. A slice keeps its coder, states and lines between
+ * calls. A slice whose bytes have not all arrived is copied at the start of a call, and
+ * again before a row that starts within twice its largest row of the last byte received.
+ * When a row runs out of bytes, the slice returns to the copy and decodes the rows since
+ * then again, and the row is retried on the next call, so nothing is decoded from missing
+ * bytes. finish() marks
+ * the end of the stream, after which decode() completes the image exactly like
+ * decompressInto() on the same bytes.
+ *
+ * Slices of a grid each decode as far as their bytes allow, and a row is reported once
+ * every slice crossing it has it. Planes of a planar slice are combined as all of them
+ * reach a row. A wavefront row decodes once its substream has fully arrived. The
+ * received bytes are kept until the decoder goes away.
+ */
+class IncrementalDecoder {
+public:
+    static constexpr size_t open = SIZE_MAX; // end of the last part, until finish()
+
+    IncrementalDecoder() = default;
+    IncrementalDecoder(const IncrementalDecoder&) = delete;
+    IncrementalDecoder& operator=(const IncrementalDecoder&) = delete;
+
+    /**
+     * @brief Appends the next `size` bytes of the stream.
+     * @return Whether the header is known, so header() can size the output.
+     */
+    bool append(const uint8_t* bytes, size_t size) {
+        if (finished) {
+            throw std::logic_error("Bytes appended after the end of the stream");
+        }
+        data.insert(data.end(), bytes, bytes + size);
+        if (!has_header) parseHeader();
+        return has_header;
+    }
+
+    /**
+     * @brief Marks the end of the stream: the last slice ends at the bytes appended so far.
+     */
+    void finish() {
+        finished = true;
+        if (!has_header) parseHeader();
+        if (!has_header) {
+            throw std::runtime_error("Truncated header");
+        }
+        for (auto& part : parts) {
+            if (part->end == open) part->end = data.size();
+            if (part->begin > part->end || part->end > data.size()) {
+                throw std::runtime_error("Truncated slice data");
+            }
+        }
+        if (!row_offsets.empty() && row_offsets.back() > data.size()) {
+            throw std::runtime_error("Truncated slice data");
+        }
+    }
+
+    bool hasHeader() const { return has_header; }
+    const Header& header() const { return header_; }
+
+    /// Rows at the top of the image that are complete in the output.
+    int rowsReady() const { return rows_ready; }
+    bool done() const { return has_header && rows_ready == int(header_.height); }
+
+    /**
+     * @brief Decodes every row the bytes received so far allow into `out`.
+     *
+     * Pass the same layout to every call: rows are written as the slices decode them, so
+     * rows below rowsReady() may already hold some of their pixels.
+     *
+     * @return rowsReady().
+     */
+    int decode(const OutputLayout& out) {
+        if (!has_header) return 0;
+        checkOutput(out, header_, header_.width, header_.height);
+        for (auto& part : parts) {
+            if (part->rows_done < part->rows) decodePart(*part, out);
+        }
+        rows_ready = 0;
+        for (int sy = 0; sy < header_.slice_rows; ++sy) {
+            int rows_out = INT_MAX;
+            for (int sx = 0; sx < header_.slice_cols; ++sx) {
+                Slice& slice = slices[size_t(sy) * header_.slice_cols + sx];
+                if (header_.planar) combinePlanes(slice, out);
+                rows_out = std::min(rows_out, slice.rows_out);
+            }
+            const Rect r = header_.slice(size_t(sy) * header_.slice_cols);
+            rows_ready = r.y + rows_out;
+            if (rows_out < r.height) break;
+        }
+        return rows_ready;
+    }
+
+private:
+    /// A slice, a plane of a planar slice or the rows of a wavefront slice, decoded as far
+    /// as its bytes allow.
+    struct Part {
+        size_t index = 0; // slice
+        int plane = 0;
+        int rows = 0;
+        int rows_done = 0;
+        size_t begin = 0; // of the bytes, or of the next row of a wavefront slice
+        size_t end = open;
+        size_t read = 0; // end of the bytes the decoder has read
+        size_t row_bytes = 0; // most bytes a row has read
+        std::optional<SliceDecoder<StreamReader>> decoder;
+        std::optional<SliceDecoder<StreamReader>> saved; // copy of the decoder at row `saved_row`
+        int saved_row = 0;
+    };
+
+    struct Slice {
+        Rect rect{};
+        int rows_out = 0; // rows written to the output
+        std::vector<int16_t> planes; // decoded rows of every plane of a planar slice
+        std::vector<int32_t> deep_planes;
+    };
+
+    void parseHeader() {
+        size_t pos = 0;
+        bool short_input = false;
+        try {
+            header_ = Header::read([&]() -> uint8_t {
+                if (pos >= data.size()) {
+                    short_input = true;
+                    throw std::runtime_error("Truncated header");
+                }
+                return data[pos++];
+            });
+        } catch (const std::runtime_error&) {
+            if (short_input && !finished) return;
+            throw;
+        }
+        requireStandalone(header_);
+        has_header = true;
+
+        const size_t start = header_.size();
+        const size_t planes = header_.planar ? header_.channels : 1;
+        slices.resize(header_.slices());
+        std::vector<size_t> offsets;
+        for (size_t i = 0; i < header_.slices(); ++i) {
+            slices[i].rect = header_.slice(i);
+            const size_t begin = start + (header_.index.empty() ? 0 : header_.index[i]);
+            const size_t end = i + 1 < header_.slices() ? start + header_.index[i + 1] : open;
+            if (header_.planar) {
+                planeOffsets(header_, i, begin, end, offsets);
+            } else {
+                offsets = {begin, end};
+            }
+            for (size_t p = 0; p < planes; ++p) {
+                auto part = std::make_unique<Part>();
+                part->index = i;
+                part->plane = int(p);
+                part->rows = slices[i].rect.height;
+                part->begin = offsets[p];
+                part->end = offsets[p + 1];
+                parts.push_back(std::move(part));
+            }
+        }
+        if (header_.wavefront_sync) {
+            rowOffsets(header_, start, open, row_offsets);
+            parts[0]->end = row_offsets[1];
+        }
+    }
+
+    /// Decodes the next rows of `part`, stopping at the first one its bytes do not complete.
+    void decodePart(Part& part, const OutputLayout& out) {
+        const Rect& r = slices[part.index].rect;
+        if (!part.decoder) {
+            // the coder reads its first bytes right away
+            if (part.begin >= data.size()) return;
+            starved = false;
+            part.decoder.emplace(r.width, header_, StreamReader{&data, &part.end, part.begin, &starved, &part.read});
+            if (starved) {
+                part.decoder.reset();
+                return;
+            }
+        }
+        if (header_.wavefront_sync) {
+            // a row substream only decodes whole, from the states of the row above
+            for (; part.rows_done < part.rows; ++part.rows_done) {
+                const int y = part.rows_done;
+                part.begin = row_offsets[y];
+                part.end = row_offsets[y + 1];
+                if (part.end > data.size()) return;
+                part.decoder->decodeSubstream(y, pixel(out, r.x, r.y + y), StreamReader{&data, &part.end, part.begin, &starved, &part.read},
+                                              out.plane_stride);
+                slices[part.index].rows_out = y + 1;
+            }
+        } else {
+            // a part whose bytes have not all arrived is copied once per call before its first
+            // row, and again before a row that starts too close to the last byte received
+            const bool complete = part.end <= data.size();
+            for (bool first = true; part.rows_done < part.rows; ++part.rows_done, first = false) {
+                const size_t start = part.read;
+                if (!complete && (first || data.size() - std::min(start, data.size()) < 2 * part.row_bytes + 64)) {
+                    saveDecoder(part);
+                }
+                starved = false;
+                try {
+                    decodeRow(part);
+                } catch (const std::exception&) {
+                    // garbage decoded from missing bytes may throw before the row ends
+                    if (!starved) throw;
+                }
+                if (starved) {
+                    // the rows since the copy read bytes that had arrived, so they decode again
+                    // to the same result
+                    const int last = part.rows_done;
+                    *part.decoder = *part.saved;
+                    for (part.rows_done = part.saved_row; part.rows_done < last; ++part.rows_done) decodeRow(part);
+                    return;
+                }
+                part.row_bytes = std::max(part.row_bytes, part.read - start);
+                writeRow(part, out);
+            }
+        }
+        part.decoder.reset();
+        part.saved.reset();
+    }
+
+    void saveDecoder(Part& part) {
+        if (part.saved && part.saved_row == part.rows_done) return;
+        if (part.saved) {
+            *part.saved = *part.decoder;
+        } else {
+            part.saved.emplace(*part.decoder);
+        }
+        part.saved_row = part.rows_done;
+    }
+
+    /// Decodes row `part.rows_done` of a part that is not a wavefront slice.
+    void decodeRow(Part& part) {
+        if (!header_.planar) {
+            part.decoder->decodeLine();
+        } else if (header_.bit_depth > 8) {
+            part.decoder->decodePlaneRow(planeRow<int32_t>(part, part.rows_done));
+        } else {
+            part.decoder->decodePlaneRow(planeRow<int16_t>(part, part.rows_done));
+        }
+    }
+
+    /// Writes the row decodeRow() just decoded; planes wait for combinePlanes().
+    void writeRow(Part& part, const OutputLayout& out) {
+        if (header_.planar) return;
+        const Rect& r = slices[part.index].rect;
+        part.decoder->writePixels(0, r.width, pixel(out, r.x, r.y + part.rows_done), out.plane_stride);
+        slices[part.index].rows_out = part.rows_done + 1;
+    }
+
+    /// Row `y` of the plane of `part`, the planes of its slice being allocated on first use.
+    template <typename Line>
+    Line* planeRow(Part& part, int y) {
+        Slice& slice = slices[part.index];
+        auto& planes = [&]() -> std::vector<Line>& {
+            if constexpr (std::is_same_v<Line, int32_t>) {
+                return slice.deep_planes;
+            } else {
+                return slice.planes;
+            }
+        }();
+        const size_t plane_size = size_t(slice.rect.width) * slice.rect.height;
+        if (planes.empty()) planes.resize(plane_size * header_.channels);
+        return planes.data() + part.plane * plane_size + size_t(y) * slice.rect.width;
+    }
+
+    /// Writes the rows every plane of `slice` has reached, then drops the planes once done.
+    void combinePlanes(Slice& slice, const OutputLayout& out) {
+        const size_t first = &slice - slices.data();
+        int rows = INT_MAX;
+        for (int p = 0; p < header_.channels; ++p) rows = std::min(rows, parts[first * header_.channels + p]->rows_done);
+        const Rect& r = slice.rect;
+        const size_t plane_size = size_t(r.width) * r.height;
+        for (int y = slice.rows_out; y < rows; ++y) {
+            uint8_t* row = pixel(out, r.x, r.y + y);
+            if (header_.bit_depth > 8) {
+                combinePlaneRow(slice.deep_planes.data() + size_t(y) * r.width, plane_size, r.width, header_.channels,
+                                reinterpret_cast<uint16_t*>(row), out.plane_stride / 2, (1 << header_.bit_depth) - 1);
+            } else {
+                combinePlaneRow(slice.planes.data() + size_t(y) * r.width, plane_size, r.width, header_.channels, row, out.plane_stride);
+            }
+        }
+        slice.rows_out = std::max(slice.rows_out, rows);
+        if (slice.rows_out == r.height) {
+            slice.planes = {};
+            slice.deep_planes = {};
+        }
+    }
+
+    /// First sample of pixel (x, y) in `out`.
+    uint8_t* pixel(const OutputLayout& out, int x, int y) const {
+        const size_t sample_size = header_.bit_depth > 8 ? 2 : 1;
+        return out.pixels + y * out.row_stride + size_t(x) * (out.plane_stride ? 1 : header_.channels) * sample_size;
+    }
+
+    std::vector<uint8_t> data; // every byte received
+    bool finished{false};
+    bool has_header{false};
+    bool starved{false}; // set by a StreamReader out of bytes
+    Header header_;
+    std::vector<Slice> slices;
+    std::vector<std::unique_ptr<Part>> parts; // in stream order, the planes of a slice together
+    std::vector<size_t> row_offsets; // of a wavefront slice
+    int rows_ready{0};
+};
+
+/**
+ * @brief Sequence encoder: frames of the same size go in one at a time and share their
+ *        states up to the next keyframe.
+ *
+ * Every frame is a revision 3 stream. A keyframe starts from the initial states and
+ * decodes on its own; the frames after it carry the states of every slice over from the
+ * previous frame, so small frames keep adapting instead of starting over. Frames go to
+ * the sink as soon as they are coded and finish() appends the frame index, so the sink
+ * can be a forward-only file.
+ *
+ * Container layout, little endian:
+ *
+ *     u8  magic_sequence
+ *     u32 keyframe interval      frame i is a keyframe when i % interval == 0
+ *     frame streams, one after the other
+ *     u64 frame offset * frames  from the start of the container
+ *     u64 offset of the frame offsets
+ *     u32 frames
+ *
+ * Slices and planes of a frame run on the pool of the options; wavefront rows are not
+ * available and samples are 8-bit.
+ */
+class SequenceEncoder {
+public:
+    using Sink = std::function<void(const uint8_t* data, size_t size)>;
+
+    SequenceEncoder(int width, int height, int channels, Sink sink, int keyframe_interval = 30, const EncodeOptions& options = {})
+        : sink(std::move(sink)), pool(options.pool ? *options.pool : ThreadPool::shared()), stats(options.stats), interval(keyframe_interval) {
+        if (keyframe_interval < 1) {
+            throw std::invalid_argument("Keyframe interval must be positive");
+        }
+        if (options.wavefront) {
+            throw std::invalid_argument("Wavefront rows are not available in a sequence");
+        }
+        if (options.bit_depth != 8) {
+            throw std::invalid_argument("Sample type does not match the bit depth");
+        }
+        initHeader(header, size_t(std::max(width, 0)) * channels * std::max(height, 0), width, height, channels, options);
+        carry.resize(header.slices() * (header.planar ? channels : 1));
+        put(magic_sequence, 1);
+        put(uint32_t(keyframe_interval), 4);
+    }
+
+    SequenceEncoder(const SequenceEncoder&) = delete;
+    SequenceEncoder& operator=(const SequenceEncoder&) = delete;
+
+    int framesWritten() const { return int(offsets.size()); }
+
+    /**
+     * @brief Codes the next frame of `width * height * channels` interleaved samples.
+     */
+    void pushFrame(const uint8_t* pixels) {
+        if (finished) {
+            throw std::logic_error("The sequence was already finished");
+        }
+        const bool keyframe = offsets.size() % interval == 0;
+        if (keyframe) {
+            for (auto& states : carry) states.reset(header);
+        }
+        header.carried_states = !keyframe;
+        const std::vector<uint8_t> frame = encodeStream(pixels, header, pool, carry.data(), stats);
+        offsets.push_back(written);
+        sink(frame.data(), frame.size());
+        written += frame.size();
+    }
+
+    /**
+     * @brief Writes the frame index; no frame can be pushed afterwards.
+     */
+    void finish() {
+        if (finished) {
+            throw std::logic_error("The sequence was already finished");
+        }
+        const uint64_t index = written;
+        for (uint64_t offset : offsets) put(offset, 8);
+        put(index, 8);
+        put(offsets.size(), 4);
+        finished = true;
+    }
+
+private:
+    void put(uint64_t x, int bytes) {
+        uint8_t buffer[8];
+        for (int i = 0; i < bytes; ++i) buffer[i] = uint8_t(x >> (8 * i));
+        sink(buffer, bytes);
+        written += bytes;
+    }
+
+    Sink sink;
+    ThreadPool& pool;
+    CodecStats* stats;
+    int interval;
+    Header header;
+    std::vector<ContextStates> carry; // per slice, or per plane of a planar slice
+    std::vector<uint64_t> offsets;
+    uint64_t written{0};
+    bool finished{false};
+};
+
+/**
+ * @brief Pulls the frames of a SequenceEncoder container out of memory, e.g. a mapped file.
+ *
+ * Frames come out in order; seek() jumps to any keyframe through the frame index. The
+ * slices and planes of a frame are decoded on the pool.
+ */
+class SequenceDecoder {
+public:
+    SequenceDecoder(const uint8_t* data, size_t size, ThreadPool* pool = nullptr)
+        : data(data), pool(pool ? *pool : ThreadPool::shared()) {
+        auto getLE = [&](size_t pos, int bytes) {
+            uint64_t x = 0;
+            for (int i = 0; i < bytes; ++i) x |= uint64_t(data[pos + i]) << (8 * i);
+            return x;
+        };
+        if (size < 17 || data[0] != magic_sequence) {
+            throw std::runtime_error("Invalid sequence container");
+        }
+        interval = uint32_t(getLE(1, 4));
+        const uint64_t frames = getLE(size - 4, 4);
+        index = getLE(size - 12, 8);
+        if (interval == 0 || index < 5 || index > size - 12 || (size - 12 - index) / 8 != frames || (size - 12 - index) % 8) {
+            throw std::runtime_error("Invalid sequence index");
+        }
+        for (uint64_t i = 0; i < frames; ++i) {
+            offsets.push_back(getLE(index + 8 * i, 8));
+            if (offsets[i] < (i ? offsets[i - 1] : 5) || offsets[i] > index || (i == 0 && offsets[0] != 5)) {
+                throw std::runtime_error("Invalid sequence index");
+            }
+        }
+        if (!offsets.empty()) {
+            first = readHeader(data + offsets[0], frameSize(0));
+            requireByteSamples(first);
+        }
+    }
+
+    SequenceDecoder(const SequenceDecoder&) = delete;
+    SequenceDecoder& operator=(const SequenceDecoder&) = delete;
+
+    int frames() const { return int(offsets.size()); }
+    int keyframeInterval() const { return int(interval); }
+    int nextFrame() const { return next; }
+    /// Header of the first frame, which all frames share but for the index and flags.
+    const Header& header() const { return first; }
+
+    /**
+     * @brief Moves to the last keyframe at or before `frame`.
+     * @return The number of that keyframe, the next frame pullFrame() returns.
+     */
+    int seek(int frame) {
+        if (frame < 0 || frame >= frames()) {
+            throw std::out_of_range("Frame out of range");
+        }
+        next = int(frame - frame % interval);
+        return next;
+    }
+
+    /**
+     * @brief Decodes the next frame into `width * height * channels` interleaved samples.
+     * @return false once every frame has been returned.
+     */
+    bool pullFrame(uint8_t* pixels, size_t capacity) {
+        if (next >= frames()) {
+            return false;
+        }
+        const uint8_t* frame = data + offsets[next];
+        const size_t size = frameSize(next);
+        current = readHeader(frame, size);
+        if (current.carried_states != (next % interval != 0) || !sameLayout(current, first)) {
+            throw std::runtime_error("Frame does not match its sequence");
+        }
+        if (current.carried_states && !carry_valid) {
+            throw std::runtime_error("Frame depends on the previous frame of its sequence");
+        }
+        if (capacity < size_t(current.width) * current.channels * current.height) {
+            throw std::invalid_argument("Output buffer is smaller than the image");
+        }
+        if (!current.carried_states) {
+            carry.resize(current.slices() * (current.planar ? current.channels : 1));
+            for (auto& states : carry) states.reset(current);
+        }
+        // a frame that fails halfway leaves the states of no use until the next keyframe
+        carry_valid = false;
+        decodeStream(frame, size, OutputLayout{pixels, capacity, size_t(current.width) * current.channels, 0}, current, pool, carry.data());
+        carry_valid = true;
+        ++next;
+        return true;
+    }
+
+private:
+    size_t frameSize(int i) const {
+        return (size_t(i) + 1 < offsets.size() ? offsets[i + 1] : index) - offsets[i];
+    }
+
+    static bool sameLayout(const Header& a, const Header& b) {
+        return a.version == b.version && a.width == b.width && a.height == b.height && a.channels == b.channels &&
+               a.bit_depth == b.bit_depth && a.model == b.model && a.coder == b.coder && a.run_mode == b.run_mode && a.planar == b.planar &&
+               a.adaptive_predictor == b.adaptive_predictor && a.initial_states == b.initial_states && a.custom_states == b.custom_states &&
+               a.slice_cols == b.slice_cols && a.slice_rows == b.slice_rows && !a.wavefront_sync && !b.wavefront_sync;
+    }
+
+    const uint8_t* data;
+    ThreadPool& pool;
+    uint32_t interval{1};
+    uint64_t index{0};
+    std::vector<uint64_t> offsets;
+    Header first;
+    Header current;
+    int next{0};
+    std::vector<ContextStates> carry;
+    bool carry_valid{false};
+};
 }
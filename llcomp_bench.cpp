@@ -0,0 +1,326 @@
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <cstdio>
+#include <cstddef>
+#include <cmath>
+#include <new>
+#include "llcomp.hpp"
+#include "batch.hpp"
+#define STB_IMAGE_IMPLEMENTATION
+   #define STBI_NO_GIF
+   #define STBI_NO_PSD
+   #define STBI_NO_PIC
+#include "stb_image.h"
+
+// Heap accounting: every operator new is counted so the peak heap and the
+// allocation count of one encode or decode call can be reported without
+// OS-specific probes.
+namespace {
+std::atomic<size_t> heap_current{0};
+std::atomic<size_t> heap_peak{0};
+std::atomic<size_t> heap_allocs{0};
+constexpr size_t heap_prefix = alignof(std::max_align_t);
+
+void resetHeapPeak() {
+    heap_peak = heap_current.load();
+}
+}
+
+void* operator new(size_t size) {
+    auto* base = static_cast<char*>(std::malloc(size + heap_prefix));
+    if (base == nullptr) {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<size_t*>(base) = size;
+    ++heap_allocs;
+    const size_t now = heap_current += size;
+    size_t peak = heap_peak.load();
+    while (now > peak && !heap_peak.compare_exchange_weak(peak, now)) {
+    }
+    return base + heap_prefix;
+}
+
+void operator delete(void* p) noexcept {
+    if (p == nullptr) return;
+    auto* base = static_cast<char*>(p) - heap_prefix;
+    heap_current -= *reinterpret_cast<size_t*>(base);
+    std::free(base);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+struct Image {
+    std::string name;
+    std::vector<uint8_t> pixels;
+    int width;
+    int height;
+    int channels;
+};
+
+struct Stat {
+    double mean = 0;
+    double stddev = 0;
+};
+
+static Stat statOf(const std::vector<double>& v) {
+    Stat s;
+    for (double x : v) s.mean += x;
+    s.mean /= v.size();
+    for (double x : v) s.stddev += (x - s.mean) * (x - s.mean);
+    s.stddev = v.size() > 1 ? std::sqrt(s.stddev / (v.size() - 1)) : 0;
+    return s;
+}
+
+static Image generate(const std::string& kind, int width, int height, int channels, std::mt19937& rng) {
+    Image img{kind, std::vector<uint8_t>(size_t(width) * height * channels), width, height, channels};
+    std::uniform_int_distribution<int> byte(0, 255);
+    uint8_t* p = img.pixels.data();
+    if (kind == "noise") {
+        for (auto& v : img.pixels) v = byte(rng);
+    } else if (kind == "gradient") {
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+                for (int c = 0; c < channels; ++c)
+                    *p++ = uint8_t((x * 255 / std::max(1, width - 1) + y * (c + 1) * 255 / std::max(1, height - 1)) / (c + 2));
+    } else if (kind == "flat") {
+        // UI-like solid panels with one pixel borders, the best case of run mode
+        std::vector<std::array<uint8_t, 4>> palette(4);
+        for (auto& color : palette)
+            for (auto& v : color) v = byte(rng);
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x) {
+                const int color = (x % 160 == 0 || y % 120 == 0) ? 3 : ((x / 160) + (y / 120)) % 3;
+                for (int c = 0; c < channels; ++c) *p++ = palette[color][c];
+            }
+    } else if (kind == "screenshot") {
+        // flat panels with a few text-like rows of high contrast glyphs
+        std::vector<std::array<uint8_t, 4>> palette(8);
+        for (auto& color : palette)
+            for (auto& v : color) v = byte(rng);
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x) {
+                int color = ((x / 96) + (y / 64) * 3) % 4;
+                if ((y % 24) >= 6 && (y % 24) < 16 && (x % 200) < 150 && ((x * 7 + y * 3) % 11) < 3) {
+                    color = 4 + (x / 200) % 4;
+                }
+                for (int c = 0; c < channels; ++c) *p++ = palette[color][c];
+            }
+    } else {
+        // smooth natural-looking content with sensor noise
+        std::normal_distribution<double> noise(0.0, 3.0);
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+                for (int c = 0; c < channels; ++c) {
+                    double v = 128 + 70 * std::sin(x * 0.021 + c) * std::cos(y * 0.017) + 30 * std::sin((x + y) * 0.003 * (c + 1)) + noise(rng);
+                    *p++ = uint8_t(std::clamp(int(std::lround(v)), 0, 255));
+                }
+    }
+    return img;
+}
+
+static std::string jsonEscape(const std::string& s) {
+    std::string out;
+    for (char ch : s) {
+        if (ch == '"' || ch == '\\') out += '\\';
+        out += ch;
+    }
+    return out;
+}
+
+int main(int argc, char** argv) {
+    llcomp::EncodeOptions options;
+    int runs = 5;
+    bool json = false;
+    bool reuse = false;
+    uint32_t seed = std::random_device{}();
+    std::vector<std::pair<int, int>> sizes{{64, 64}, {256, 256}, {1024, 768}};
+    std::vector<std::string> photos;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc) {
+            runs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--json") {
+            json = true;
+        } else if (arg == "--reuse") {
+            reuse = true;
+        } else if (arg == "--wide") {
+            options.coder = llcomp::Coder::WideRange;
+        } else if (arg == "--fast") {
+            options.coder = llcomp::Coder::GolombRice;
+        } else if (arg == "--no-run-mode") {
+            options.run_mode = false;
+        } else if (arg == "--wavefront") {
+            options.wavefront = true;
+        } else if (arg == "--planar") {
+            options.planar = true;
+        } else if (arg == "--adaptive") {
+            options.adaptive_predictor = true;
+        } else if (arg == "--states" && i + 1 < argc) {
+            if (!llcomp::parseStates(argv[++i], options)) {
+                std::cerr << "Cannot read initial states: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--slices" && i + 1 < argc) {
+            char sep = 0;
+            std::istringstream grid(argv[++i]);
+            grid >> options.slice_cols >> sep >> options.slice_rows;
+        } else if (arg == "--model" && i + 1 < argc) {
+            const std::string name = argv[++i];
+            for (int m = 0; m < llcomp::models_nb; ++m) {
+                if (name == llcomp::modelName(llcomp::Model(m))) options.model = llcomp::Model(m);
+            }
+        } else if (arg == "--sizes" && i + 1 < argc) {
+            sizes.clear();
+            std::istringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                int w = 0, h = 0;
+                char sep = 0;
+                std::istringstream(item) >> w >> sep >> h;
+                if (w > 0 && h > 0) sizes.emplace_back(w, h);
+            }
+        } else if (arg == "--help" || arg == "-h") {
+            std::cerr << "Usage: " << argv[0] << " [--runs N] [--seed N] [--json] [--reuse] [--wide|--fast] [--no-run-mode] [--wavefront|--planar] [--adaptive] [--states default|trained|FILE] [--slices COLSxROWS] [--model tiny|small|large] [--sizes WxH,...] [photo...]" << std::endl;
+            return 0;
+        } else {
+            photos.push_back(arg);
+        }
+    }
+
+    std::mt19937 rng(seed);
+    std::vector<Image> corpus;
+    for (const auto& kind : {"noise", "gradient", "flat", "screenshot", "photo"}) {
+        for (auto [w, h] : sizes) {
+            for (int channels = 1; channels <= 4; ++channels) {
+                corpus.push_back(generate(kind, w, h, channels, rng));
+            }
+        }
+    }
+    for (const auto& path : photos) {
+        for (int channels = 1; channels <= 4; ++channels) {
+            int width, height, file_channels;
+            auto stb_img = stbi_load(path.c_str(), &width, &height, &file_channels, channels);
+            if (stb_img == nullptr) {
+                std::cerr << "Error loading image " << path << ": " << stbi_failure_reason() << std::endl;
+                return 1;
+            }
+            corpus.push_back({path, std::vector<uint8_t>(stb_img, stb_img + size_t(width) * height * channels), width, height, channels});
+            stbi_image_free(stb_img);
+        }
+    }
+
+    using clock = std::chrono::steady_clock;
+    bool failed = false;
+    llcomp::CodecContext context;
+    if (json) {
+        std::cout << "{\n  \"revision\": " << int(llcomp::revision) << ",\n  \"simd\": \"" << llcomp::rowmodel::kernels().name
+                  << "\",\n  \"seed\": " << seed << ",\n  \"runs\": " << runs
+                  << ",\n  \"slices\": \"" << options.slice_cols << "x" << options.slice_rows
+                  << "\",\n  \"model\": \"" << (options.model ? llcomp::modelName(*options.model) : "auto")
+                  << "\",\n  \"coder\": \"" << llcomp::coderName(options.coder)
+                  << "\",\n  \"run_mode\": " << (options.run_mode ? "true" : "false")
+                  << ",\n  \"wavefront\": " << (options.wavefront ? "true" : "false")
+                  << ",\n  \"planar\": " << (options.planar ? "true" : "false")
+                  << ",\n  \"adaptive_predictor\": " << (options.adaptive_predictor ? "true" : "false")
+                  << ",\n  \"initial_states\": \"" << llcomp::initialStatesName(options.initial_states) << "\""
+                  << ",\n  \"reuse\": " << (reuse ? "true" : "false") << ",\n  \"cases\": [";
+    } else {
+        std::cout << "seed " << seed << ", " << runs << " runs, " << llcomp::rowmodel::kernels().name << " kernels, "
+                  << (options.model ? llcomp::modelName(*options.model) : "auto") << " model, "
+                  << llcomp::coderName(options.coder) << " coder" << (options.run_mode ? "" : ", no run mode")
+                  << (options.wavefront ? ", wavefront rows" : "")
+                  << (options.planar ? ", planar" : "")
+                  << (options.adaptive_predictor ? ", adaptive predictors" : "")
+                  << ", " << llcomp::initialStatesName(options.initial_states) << " initial states"
+                  << (reuse ? ", reused context" : "") << "\n";
+        std::cout << "case                      size        ch      bpp   enc MB/s (+-%)    dec MB/s (+-%)   enc KiB   dec KiB\n";
+    }
+
+    for (size_t n = 0; n < corpus.size(); ++n) {
+        const Image& img = corpus[n];
+        const double mb = img.pixels.size() / 1e6;
+        std::vector<double> enc, dec;
+        std::vector<uint8_t> compressed;
+        llcomp::RawImage raw{};
+        size_t enc_peak = 0, dec_peak = 0;
+        size_t enc_allocs = 0, dec_allocs = 0;
+        for (int run = 0; run < runs; ++run) {
+            if (!reuse) {
+                compressed.clear();
+                compressed.shrink_to_fit();
+                raw = {};
+            }
+            size_t base = heap_current;
+            size_t allocs = heap_allocs;
+            resetHeapPeak();
+            auto t0 = clock::now();
+            if (reuse) {
+                context.compress(img.pixels, img.width, img.height, img.channels, compressed, options);
+            } else {
+                compressed = llcomp::compressImage(img.pixels, img.width, img.height, img.channels, options);
+            }
+            auto t1 = clock::now();
+            enc_peak = std::max(enc_peak, heap_peak - base);
+            enc_allocs = heap_allocs - allocs;
+
+            base = heap_current;
+            allocs = heap_allocs;
+            resetHeapPeak();
+            auto t2 = clock::now();
+            if (reuse) {
+                context.decompress(compressed, raw);
+            } else {
+                raw = llcomp::decompressImage(compressed);
+            }
+            auto t3 = clock::now();
+            dec_peak = std::max(dec_peak, heap_peak - base);
+            dec_allocs = heap_allocs - allocs;
+
+            if (raw.pixels != img.pixels) {
+                std::cerr << "Round trip mismatch: " << img.name << std::endl;
+                failed = true;
+            }
+            // the first run grows the reused buffers, the next ones must not allocate
+            if (reuse && run > 0 && enc_allocs + dec_allocs != 0) {
+                std::cerr << "Reused context allocated: " << img.name << std::endl;
+                failed = true;
+            }
+            enc.push_back(mb / std::chrono::duration<double>(t1 - t0).count());
+            dec.push_back(mb / std::chrono::duration<double>(t3 - t2).count());
+        }
+        const Stat e = statOf(enc);
+        const Stat d = statOf(dec);
+        const double bpp = compressed.size() * 8.0 / (double(img.width) * img.height);
+        if (json) {
+            std::cout << (n ? "," : "") << "\n    {\"name\": \"" << jsonEscape(img.name) << "\", \"width\": " << img.width
+                      << ", \"height\": " << img.height << ", \"channels\": " << img.channels
+                      << ", \"raw_bytes\": " << img.pixels.size() << ", \"compressed_bytes\": " << compressed.size()
+                      << ", \"bpp\": " << bpp
+                      << ", \"encode_mbps\": " << e.mean << ", \"encode_mbps_stddev\": " << e.stddev
+                      << ", \"decode_mbps\": " << d.mean << ", \"decode_mbps_stddev\": " << d.stddev
+                      << ", \"encode_peak_heap\": " << enc_peak << ", \"decode_peak_heap\": " << dec_peak
+                      << ", \"encode_allocs\": " << enc_allocs << ", \"decode_allocs\": " << dec_allocs << "}";
+        } else {
+            char line[256];
+            std::snprintf(line, sizeof(line), "%-24s %5dx%-5d %2d %8.3f %9.2f (%4.1f) %9.2f (%4.1f) %9zu %9zu\n",
+                          img.name.substr(0, 24).c_str(), img.width, img.height, img.channels, bpp,
+                          e.mean, 100 * e.stddev / e.mean, d.mean, 100 * d.stddev / d.mean, enc_peak / 1024, dec_peak / 1024);
+            std::cout << line;
+        }
+    }
+    if (json) {
+        std::cout << "\n  ]\n}" << std::endl;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,257 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+// Initial states of the range coders, generated by llcomp_train from 1890 tiles of 64x64 pixels
+// with a window of 32 decisions; see llcomp::trainedStates().
+
+namespace llcomp {
+constexpr inline std::array<uint8_t, 504> trained_tiny_states = {
+    19, 87, 87, 59, 33, 8, 18, 9, 8, 3, 20, 9, 3, 14, 6, 29, 13, 117, 99, 39, 9, 8, 2, 29,
+    24, 29, 3, 12, 4, 10, 6, 12, 17, 18, 32, 42, 8, 24, 14, 20, 25, 14, 50, 34, 8, 22, 16, 38,
+    38, 4, 54, 48, 48, 16, 14, 9, 122, 65, 39, 25, 5, 10, 2, 31, 31, 87, 65, 29, 9, 8, 0, 12,
+    13, 25, 1, 8, 8, 12, 4, 12, 89, 65, 51, 15, 13, 2, 4, 38, 98, 13, 18, 0, 2, 6, 2, 25,
+    126, 125, 125, 51, 9, 6, 2, 31, 126, 111, 65, 25, 1, 8, 2, 8, 52, 21, 0, 12, 16, 16, 10, 9,
+    8, 25, 9, 16, 8, 10, 6, 43, 38, 27, 4, 42, 24, 16, 6, 35, 24, 51, 17, 3, 0, 8, 4, 17,
+    74, 29, 1, 0, 8, 8, 6, 8, 34, 4, 42, 74, 30, 16, 20, 9, 12, 8, 38, 50, 8, 18, 18, 51,
+    24, 16, 38, 84, 34, 24, 14, 39, 46, 31, 9, 8, 4, 10, 4, 17, 24, 51, 17, 9, 1, 10, 4, 12,
+    0, 12, 38, 42, 0, 20, 16, 12, 1, 2, 8, 0, 2, 16, 6, 51, 16, 0, 42, 92, 34, 20, 20, 57,
+    8, 25, 3, 0, 4, 10, 4, 39, 24, 17, 4, 30, 24, 12, 6, 8, 12, 10, 44, 80, 46, 22, 22, 13,
+    0, 8, 54, 50, 18, 20, 14, 8, 28, 0, 38, 50, 24, 20, 14, 3, 50, 15, 2, 8, 16, 12, 4, 1,
+    24, 29, 3, 13, 0, 4, 2, 17, 30, 13, 12, 22, 30, 16, 6, 9, 0, 17, 9, 2, 8, 12, 2, 8,
+    58, 29, 1, 2, 18, 12, 2, 4, 126, 123, 75, 31, 1, 8, 2, 8, 126, 127, 117, 51, 5, 8, 0, 8,
+    96, 39, 13, 13, 1, 8, 4, 9, 13, 67, 51, 17, 3, 8, 4, 25, 38, 39, 17, 0, 2, 8, 8, 17,
+    16, 113, 73, 35, 9, 8, 2, 21, 100, 55, 25, 17, 1, 10, 2, 8, 46, 13, 16, 24, 30, 14, 12, 3,
+    12, 19, 12, 28, 18, 12, 6, 43, 12, 17, 4, 28, 24, 12, 8, 21, 34, 59, 25, 9, 2, 8, 0, 17,
+    20, 121, 109, 43, 13, 4, 0, 8, 28, 19, 2, 13, 5, 10, 2, 0, 9, 85, 65, 29, 11, 4, 2, 65,
+    16, 17, 4, 8, 8, 14, 0, 39, 8, 75, 51, 25, 1, 8, 6, 43, 48, 85, 43, 21, 1, 10, 4, 9,
+    24, 25, 3, 0, 0, 12, 4, 17, 16, 25, 1, 25, 3, 4, 0, 5, 46, 13, 12, 16, 20, 10, 8, 13,
+    106, 47, 19, 13, 0, 8, 0, 17, 46, 125, 117, 61, 9, 6, 2, 25, 62, 85, 51, 21, 1, 10, 2, 17,
+    2, 115, 87, 39, 9, 4, 2, 4, 114, 65, 39, 31, 3, 8, 2, 12, 126, 127, 123, 65, 9, 6, 2, 12
+};
+
+constexpr inline std::array<uint8_t, 5328> trained_small_states = {
+    19, 87, 87, 59, 33, 8, 18, 9, 8, 28, 8, 9, 1, 24, 4, 35, 0, 65, 2, 16, 1, 24, 22, 35,
+    16, 113, 67, 9, 12, 14, 2, 21, 0, 125, 115, 81, 1, 2, 2, 25, 9, 125, 125, 117, 19, 0, 0, 29,
+    12, 43, 69, 71, 7, 8, 2, 1, 20, 25, 13, 9, 10, 8, 2, 1, 18, 13, 2, 34, 42, 18, 6, 8,
+    18, 4, 42, 80, 18, 20, 20, 20, 13, 42, 48, 28, 0, 30, 14, 12, 17, 36, 44, 24, 0, 28, 12, 38,
+    16, 30, 54, 62, 58, 28, 18, 3, 34, 1, 34, 62, 66, 22, 24, 13, 50, 13, 13, 12, 42, 18, 1, 9,
+    66, 17, 35, 43, 6, 4, 8, 13, 126, 51, 125, 107, 13, 12, 1, 31, 24, 87, 65, 47, 11, 8, 4, 1,
+    38, 47, 17, 9, 16, 8, 0, 1, 40, 31, 2, 34, 38, 16, 12, 12, 29, 15, 12, 54, 8, 24, 22, 12,
+    2, 0, 40, 68, 34, 22, 18, 22, 31, 25, 12, 92, 8, 38, 50, 50, 36, 6, 42, 58, 26, 20, 20, 2,
+    48, 25, 30, 54, 40, 18, 24, 9, 70, 51, 9, 4, 52, 14, 2, 13, 102, 85, 25, 31, 6, 2, 4, 17,
+    126, 127, 81, 117, 21, 8, 0, 51, 16, 123, 97, 65, 13, 6, 0, 2, 38, 87, 41, 13, 8, 6, 6, 3,
+    25, 43, 15, 2, 12, 10, 6, 8, 0, 33, 0, 18, 30, 14, 4, 8, 0, 17, 1, 24, 30, 12, 4, 10,
+    49, 29, 3, 8, 18, 14, 4, 20, 60, 8, 0, 20, 48, 12, 4, 9, 84, 57, 8, 28, 48, 12, 12, 17,
+    96, 85, 43, 14, 70, 8, 2, 25, 126, 107, 79, 43, 6, 4, 4, 25, 126, 127, 127, 111, 21, 12, 2, 63,
+    30, 127, 127, 123, 13, 2, 0, 8, 51, 75, 65, 35, 1, 8, 4, 12, 13, 67, 35, 13, 12, 10, 6, 1,
+    17, 39, 25, 3, 10, 8, 1, 2, 17, 21, 21, 0, 5, 14, 0, 0, 81, 51, 43, 17, 8, 2, 4, 16,
+    114, 20, 17, 1, 8, 16, 10, 29, 126, 95, 0, 18, 18, 8, 16, 25, 126, 117, 81, 1, 34, 14, 1, 25,
+    126, 127, 127, 81, 4, 0, 2, 37, 126, 127, 127, 127, 21, 8, 0, 51, 51, 125, 123, 81, 21, 0, 1, 24,
+    35, 121, 121, 81, 9, 4, 2, 16, 29, 117, 89, 55, 1, 12, 6, 0, 29, 59, 57, 19, 3, 2, 0, 12,
+    25, 35, 51, 31, 9, 12, 10, 8, 109, 125, 125, 117, 19, 17, 1, 50, 122, 30, 25, 35, 13, 8, 4, 43,
+    126, 125, 0, 16, 7, 22, 24, 43, 126, 127, 125, 15, 16, 16, 1, 29, 126, 127, 127, 121, 1, 0, 4, 29,
+    126, 127, 127, 127, 23, 8, 0, 29, 126, 127, 127, 127, 19, 28, 0, 32, 126, 123, 125, 83, 1, 16, 4, 22,
+    126, 127, 123, 7, 2, 0, 0, 0, 124, 81, 35, 51, 54, 50, 88, 50, 8, 2, 13, 19, 7, 2, 8, 8,
+    13, 8, 25, 19, 5, 0, 2, 59, 28, 9, 29, 17, 6, 68, 10, 11, 18, 21, 7, 6, 0, 14, 9, 27,
+    0, 35, 41, 39, 4, 1, 29, 41, 28, 23, 43, 33, 7, 3, 0, 9, 0, 25, 67, 99, 15, 1, 4, 31,
+    126, 127, 127, 127, 13, 3, 2, 28, 118, 121, 63, 39, 10, 8, 0, 2, 122, 65, 55, 0, 40, 14, 8, 0,
+    78, 39, 7, 8, 82, 8, 12, 0, 30, 9, 35, 1, 10, 12, 0, 8, 2, 25, 17, 13, 6, 6, 2, 23,
+    32, 41, 7, 8, 3, 10, 2, 1, 30, 31, 3, 6, 26, 6, 12, 3, 50, 43, 21, 0, 16, 4, 2, 1,
+    12, 35, 37, 25, 10, 18, 0, 9, 26, 103, 127, 65, 7, 9, 8, 9, 126, 127, 81, 41, 13, 14, 4, 22,
+    122, 73, 45, 9, 26, 4, 4, 6, 70, 45, 17, 16, 58, 12, 2, 2, 64, 35, 0, 24, 54, 14, 18, 0,
+    54, 1, 2, 46, 34, 10, 4, 0, 8, 19, 0, 24, 24, 14, 4, 25, 16, 17, 6, 34, 58, 14, 4, 21,
+    48, 25, 4, 48, 42, 14, 6, 19, 48, 25, 5, 18, 62, 14, 6, 9, 72, 65, 25, 7, 40, 12, 4, 4,
+    46, 127, 93, 35, 9, 12, 2, 0, 126, 77, 43, 31, 13, 16, 8, 8, 76, 47, 13, 9, 12, 12, 8, 4,
+    62, 31, 0, 26, 72, 10, 0, 2, 36, 11, 26, 50, 46, 16, 14, 1, 32, 0, 38, 70, 62, 20, 22, 13,
+    12, 3, 32, 116, 34, 16, 22, 49, 24, 0, 42, 122, 12, 26, 18, 35, 20, 3, 26, 114, 46, 16, 20, 17,
+    54, 33, 1, 46, 58, 14, 12, 17, 50, 37, 11, 0, 26, 6, 2, 2, 42, 69, 65, 35, 7, 10, 14, 13,
+    120, 3, 43, 51, 13, 2, 4, 9, 58, 15, 17, 17, 10, 6, 4, 2, 48, 9, 0, 24, 16, 20, 12, 2,
+    36, 0, 38, 84, 28, 20, 20, 8, 16, 16, 70, 50, 18, 16, 24, 7, 12, 38, 74, 40, 4, 40, 24, 77,
+    16, 38, 74, 48, 22, 42, 22, 51, 28, 7, 38, 110, 44, 26, 18, 35, 32, 21, 7, 12, 8, 16, 10, 13,
+    40, 35, 25, 35, 1, 1, 0, 0, 20, 75, 95, 81, 13, 0, 0, 9, 34, 87, 99, 89, 9, 4, 2, 2,
+    12, 25, 19, 17, 6, 8, 2, 1, 12, 15, 1, 16, 24, 16, 6, 12, 14, 1, 36, 62, 8, 20, 16, 18,
+    3, 34, 56, 30, 1, 30, 14, 18, 1, 20, 12, 0, 8, 18, 6, 51, 16, 14, 64, 68, 8, 30, 28, 55,
+    18, 9, 28, 92, 58, 14, 20, 51, 6, 5, 8, 24, 74, 14, 6, 29, 8, 13, 13, 9, 10, 8, 2, 29,
+    3, 17, 51, 41, 13, 8, 2, 23, 12, 21, 39, 27, 0, 26, 4, 1, 20, 9, 1, 0, 16, 12, 0, 7,
+    32, 9, 8, 46, 50, 20, 6, 0, 14, 6, 46, 122, 62, 26, 16, 12, 8, 30, 64, 54, 36, 28, 26, 23,
+    0, 24, 54, 68, 4, 30, 26, 10, 12, 14, 50, 70, 26, 28, 14, 9, 28, 0, 28, 50, 1, 20, 18, 13,
+    28, 2, 10, 22, 60, 14, 4, 3, 24, 3, 1, 2, 26, 6, 2, 2, 54, 2, 11, 17, 5, 16, 0, 22,
+    16, 39, 29, 15, 13, 12, 0, 5, 36, 35, 3, 8, 28, 8, 4, 9, 38, 23, 6, 58, 64, 14, 10, 0,
+    24, 3, 32, 92, 56, 16, 20, 3, 20, 2, 46, 70, 24, 28, 22, 0, 4, 0, 44, 74, 36, 20, 10, 20,
+    30, 0, 42, 94, 58, 20, 16, 6, 38, 7, 26, 50, 36, 14, 14, 2, 38, 15, 10, 26, 80, 12, 8, 2,
+    52, 29, 1, 2, 30, 14, 6, 4, 78, 47, 17, 25, 7, 6, 4, 3, 22, 99, 73, 19, 7, 1, 7, 4,
+    62, 71, 37, 0, 18, 12, 0, 9, 34, 23, 7, 14, 30, 12, 6, 15, 52, 9, 4, 30, 44, 16, 12, 9,
+    30, 3, 4, 30, 42, 16, 18, 1, 8, 3, 0, 26, 34, 10, 2, 12, 42, 11, 1, 30, 34, 18, 8, 12,
+    60, 33, 8, 30, 124, 4, 4, 2, 76, 45, 9, 22, 44, 12, 6, 0, 102, 65, 33, 3, 22, 6, 4, 2,
+    126, 127, 51, 43, 19, 12, 1, 13, 8, 127, 127, 87, 11, 10, 2, 2, 12, 17, 31, 19, 4, 4, 2, 13,
+    50, 19, 17, 0, 30, 4, 6, 17, 16, 13, 9, 10, 38, 6, 10, 5, 32, 9, 5, 0, 22, 8, 10, 9,
+    16, 9, 25, 1, 10, 8, 5, 1, 82, 35, 15, 1, 24, 10, 8, 8, 116, 67, 17, 0, 34, 16, 10, 8,
+    118, 65, 35, 5, 44, 6, 4, 0, 126, 127, 81, 35, 16, 6, 1, 1, 126, 127, 127, 93, 9, 18, 0, 8,
+    16, 24, 123, 75, 13, 12, 3, 35, 80, 8, 81, 31, 3, 11, 0, 25, 42, 17, 25, 27, 7, 12, 3, 1,
+    40, 35, 25, 51, 9, 5, 9, 1, 10, 8, 4, 5, 0, 10, 6, 17, 9, 3, 17, 31, 9, 12, 1, 3,
+    42, 3, 10, 27, 5, 32, 4, 23, 126, 87, 19, 21, 6, 20, 4, 0, 126, 127, 101, 49, 3, 1, 14, 42,
+    126, 127, 127, 81, 3, 8, 4, 12, 126, 127, 125, 111, 13, 8, 2, 0, 126, 127, 127, 127, 21, 22, 3, 12,
+    126, 127, 127, 125, 1, 12, 4, 8, 126, 127, 121, 25, 5, 16, 1, 0, 126, 71, 19, 49, 13, 12, 1, 1,
+    24, 35, 21, 29, 3, 26, 8, 11, 17, 39, 39, 35, 5, 8, 5, 27, 34, 59, 41, 31, 11, 22, 0, 13,
+    50, 63, 43, 13, 5, 16, 10, 19, 34, 85, 53, 35, 16, 12, 3, 19, 42, 121, 81, 71, 13, 9, 4, 25,
+    8, 117, 63, 63, 11, 12, 0, 9, 126, 127, 125, 127, 13, 4, 2, 12, 126, 115, 63, 35, 10, 4, 2, 8,
+    98, 69, 35, 7, 12, 2, 2, 1, 108, 47, 13, 1, 20, 12, 4, 3, 76, 25, 19, 11, 8, 22, 10, 13,
+    12, 39, 31, 9, 10, 10, 4, 31, 36, 25, 19, 1, 4, 2, 4, 11, 50, 53, 21, 0, 18, 10, 2, 7,
+    54, 63, 27, 1, 18, 10, 2, 1, 34, 79, 29, 9, 6, 8, 4, 9, 56, 127, 125, 77, 13, 40, 0, 0,
+    126, 127, 103, 39, 3, 2, 4, 0, 108, 69, 35, 9, 28, 4, 0, 2, 84, 45, 21, 10, 54, 10, 6, 2,
+    58, 31, 1, 22, 42, 10, 8, 3, 46, 19, 1, 24, 46, 14, 6, 13, 12, 37, 3, 30, 34, 8, 4, 33,
+    52, 29, 1, 48, 34, 10, 10, 39, 56, 37, 0, 54, 34, 10, 6, 35, 48, 49, 7, 16, 42, 8, 6, 13,
+    70, 67, 35, 5, 28, 8, 4, 0, 34, 93, 75, 23, 1, 4, 0, 8, 126, 117, 39, 51, 13, 0, 4, 12,
+    86, 67, 3, 9, 12, 18, 4, 1, 68, 41, 2, 18, 58, 2, 8, 3, 38, 11, 30, 58, 50, 16, 24, 5,
+    44, 3, 32, 88, 44, 18, 12, 25, 0, 39, 12, 74, 0, 20, 24, 51, 34, 13, 26, 100, 34, 20, 20, 35,
+    20, 17, 8, 100, 54, 24, 28, 25, 54, 31, 3, 24, 24, 14, 4, 17, 38, 39, 25, 13, 8, 12, 10, 9,
+    40, 115, 55, 31, 7, 16, 1, 0, 78, 25, 35, 21, 9, 2, 2, 0, 62, 19, 17, 5, 16, 10, 4, 2,
+    52, 17, 0, 22, 42, 14, 12, 6, 32, 3, 32, 80, 56, 18, 24, 2, 24, 10, 46, 70, 18, 20, 24, 11,
+    8, 4, 46, 80, 60, 22, 24, 53, 18, 4, 44, 76, 32, 26, 18, 21, 38, 11, 20, 120, 56, 14, 14, 35,
+    36, 29, 7, 0, 8, 12, 2, 5, 44, 31, 9, 2, 24, 10, 8, 9, 20, 29, 47, 19, 4, 0, 0, 9,
+    34, 127, 97, 65, 13, 8, 4, 8, 24, 59, 19, 13, 6, 6, 2, 1, 16, 33, 0, 16, 18, 10, 6, 8,
+    8, 25, 8, 96, 12, 30, 38, 24, 12, 8, 38, 30, 1, 20, 12, 1, 1, 29, 9, 16, 4, 28, 18, 51,
+    18, 2, 34, 116, 28, 16, 20, 53, 24, 25, 26, 72, 40, 16, 10, 55, 12, 25, 8, 16, 48, 10, 2, 35,
+    12, 35, 1, 9, 6, 10, 8, 29, 0, 63, 43, 51, 13, 18, 4, 19, 12, 39, 19, 1, 1, 14, 2, 9,
+    28, 25, 3, 1, 24, 12, 6, 5, 36, 21, 4, 42, 50, 14, 10, 2, 26, 3, 30, 92, 42, 18, 24, 1,
+    18, 1, 42, 62, 24, 18, 18, 25, 1, 10, 50, 42, 18, 18, 14, 3, 24, 6, 38, 62, 30, 14, 18, 15,
+    34, 3, 26, 66, 58, 16, 14, 23, 44, 9, 10, 28, 60, 14, 10, 21, 58, 13, 5, 2, 20, 16, 8, 7,
+    60, 13, 25, 35, 5, 22, 3, 3, 12, 37, 25, 13, 5, 14, 2, 8, 28, 41, 5, 10, 42, 10, 6, 15,
+    34, 27, 4, 48, 64, 16, 10, 1, 30, 15, 24, 72, 50, 18, 12, 13, 22, 1, 42, 56, 24, 22, 20, 9,
+    8, 11, 38, 30, 8, 20, 14, 10, 26, 0, 32, 58, 92, 18, 14, 0, 34, 9, 24, 42, 50, 20, 10, 1,
+    38, 15, 14, 30, 64, 14, 10, 3, 52, 33, 1, 8, 22, 10, 6, 3, 126, 97, 13, 13, 7, 8, 10, 0,
+    16, 85, 49, 25, 1, 6, 8, 2, 34, 61, 33, 2, 30, 8, 4, 13, 30, 57, 11, 22, 50, 8, 4, 29,
+    52, 29, 8, 36, 34, 16, 10, 19, 24, 13, 12, 34, 74, 18, 10, 9, 8, 25, 2, 16, 24, 12, 2, 12,
+    38, 7, 0, 24, 34, 14, 2, 4, 44, 19, 2, 32, 58, 14, 4, 8, 60, 33, 1, 16, 64, 8, 6, 2,
+    84, 65, 25, 2, 28, 10, 4, 2, 118, 127, 75, 25, 5, 16, 2, 9, 12, 127, 117, 75, 13, 22, 3, 24,
+    16, 65, 25, 9, 8, 4, 2, 13, 74, 79, 17, 3, 16, 12, 2, 25, 54, 53, 11, 4, 30, 8, 4, 5,
+    50, 21, 9, 3, 36, 16, 6, 3, 12, 65, 17, 9, 16, 8, 6, 12, 72, 25, 23, 9, 30, 10, 0, 8,
+    84, 51, 23, 9, 16, 10, 2, 12, 98, 77, 35, 9, 18, 4, 4, 4, 126, 113, 61, 31, 14, 6, 2, 0,
+    126, 127, 123, 125, 7, 2, 0, 8, 16, 125, 0, 9, 13, 12, 12, 35, 124, 125, 17, 17, 1, 4, 6, 9,
+    42, 63, 11, 35, 7, 16, 0, 25, 16, 35, 9, 3, 3, 18, 6, 21, 0, 25, 7, 13, 3, 16, 2, 5,
+    25, 25, 33, 25, 1, 8, 0, 2, 86, 3, 29, 35, 1, 18, 0, 13, 126, 125, 21, 13, 1, 6, 0, 1,
+    126, 107, 111, 35, 1, 2, 4, 12, 126, 127, 127, 123, 7, 4, 2, 16, 126, 127, 127, 93, 13, 2, 2, 16,
+    126, 127, 127, 127, 19, 8, 2, 12, 126, 127, 127, 125, 7, 12, 2, 3, 126, 127, 93, 39, 1, 12, 2, 12,
+    124, 125, 39, 39, 13, 12, 7, 17, 120, 85, 63, 39, 11, 8, 1, 25, 9, 31, 87, 41, 7, 12, 0, 25,
+    64, 1, 13, 8, 0, 2, 22, 24, 62, 87, 81, 13, 13, 8, 4, 9, 38, 65, 75, 51, 1, 8, 0, 9,
+    50, 127, 115, 75, 9, 4, 0, 9, 30, 127, 93, 39, 13, 4, 8, 13, 126, 125, 127, 125, 13, 8, 2, 0,
+    126, 125, 71, 43, 4, 0, 2, 0, 112, 97, 43, 13, 16, 4, 2, 0, 114, 67, 21, 1, 10, 16, 2, 3,
+    58, 25, 25, 13, 6, 14, 8, 9, 8, 75, 43, 17, 6, 12, 8, 21, 50, 39, 25, 9, 18, 8, 8, 5,
+    64, 51, 31, 13, 24, 10, 1, 13, 80, 93, 45, 13, 18, 16, 4, 7, 34, 109, 43, 17, 6, 8, 2, 9,
+    62, 67, 127, 103, 15, 12, 5, 25, 126, 127, 127, 25, 13, 12, 1, 0, 112, 87, 47, 13, 30, 12, 4, 1,
+    84, 53, 25, 2, 56, 10, 2, 1, 64, 43, 9, 16, 50, 10, 8, 9, 50, 23, 15, 4, 30, 16, 4, 21,
+    16, 55, 25, 0, 34, 12, 0, 25, 46, 35, 13, 18, 50, 14, 6, 25, 64, 43, 7, 28, 42, 10, 6, 19,
+    38, 55, 23, 2, 34, 8, 4, 9, 62, 91, 45, 15, 8, 4, 6, 0, 42, 113, 89, 65, 11, 4, 0, 1,
+    126, 93, 31, 25, 13, 8, 2, 0, 82, 53, 17, 0, 26, 8, 6, 2, 62, 45, 5, 12, 62, 12, 2, 0,
+    46, 21, 12, 28, 54, 12, 14, 9, 54, 19, 12, 50, 28, 22, 18, 21, 12, 25, 4, 40, 40, 14, 8, 47,
+    46, 17, 4, 46, 36, 10, 8, 29, 34, 35, 4, 36, 24, 14, 10, 17, 58, 45, 13, 8, 42, 12, 6, 0,
+    56, 47, 17, 1, 16, 10, 4, 0, 38, 75, 59, 31, 11, 24, 0, 3, 88, 41, 31, 51, 13, 22, 7, 8,
+    66, 35, 13, 13, 26, 12, 2, 4, 54, 17, 7, 18, 54, 8, 8, 4, 40, 7, 18, 36, 52, 18, 14, 1,
+    32, 5, 12, 42, 54, 18, 12, 13, 8, 5, 14, 30, 24, 16, 10, 23, 14, 3, 12, 30, 124, 18, 10, 3,
+    38, 17, 4, 18, 48, 14, 4, 13, 36, 37, 7, 6, 32, 6, 8, 7, 52, 51, 13, 5, 34, 10, 0, 11,
+    8, 55, 31, 5, 1, 28, 2, 4, 28, 125, 121, 75, 13, 6, 4, 0, 30, 87, 51, 35, 2, 8, 4, 0,
+    12, 43, 13, 1, 12, 8, 2, 2, 20, 25, 8, 2, 4, 8, 4, 2, 16, 9, 1, 0, 0, 12, 6, 5,
+    9, 51, 31, 17, 0, 8, 2, 35, 12, 3, 2, 22, 42, 20, 10, 23, 12, 31, 6, 30, 30, 12, 12, 31,
+    12, 39, 9, 0, 58, 12, 2, 25, 8, 55, 31, 15, 10, 6, 4, 21, 9, 93, 87, 43, 13, 12, 2, 33,
+    32, 75, 47, 49, 6, 14, 2, 9, 42, 51, 25, 0, 26, 10, 4, 3, 40, 35, 1, 16, 50, 14, 8, 9,
+    46, 21, 0, 24, 54, 20, 8, 13, 20, 13, 2, 24, 24, 12, 8, 29, 8, 5, 8, 22, 28, 10, 12, 13,
+    32, 6, 4, 20, 94, 36, 10, 17, 50, 11, 10, 24, 50, 12, 14, 19, 60, 15, 0, 14, 60, 6, 4, 17,
+    92, 23, 13, 2, 30, 8, 0, 15, 124, 13, 59, 29, 0, 10, 4, 1, 34, 55, 35, 17, 7, 14, 3, 1,
+    46, 53, 17, 2, 26, 8, 4, 13, 50, 49, 13, 24, 58, 10, 4, 21, 42, 41, 1, 32, 50, 14, 4, 41,
+    36, 17, 8, 40, 34, 18, 10, 29, 8, 25, 16, 32, 34, 12, 10, 1, 38, 5, 14, 42, 64, 14, 12, 5,
+    42, 19, 16, 30, 70, 14, 10, 9, 58, 27, 2, 20, 46, 12, 8, 15, 80, 47, 9, 4, 16, 10, 4, 11,
+    126, 107, 25, 9, 7, 18, 8, 1, 8, 59, 35, 25, 1, 14, 1, 1, 34, 73, 31, 0, 30, 6, 2, 13,
+    50, 77, 37, 14, 62, 8, 2, 43, 62, 57, 9, 32, 80, 10, 4, 35, 30, 15, 0, 30, 48, 14, 6, 13,
+    8, 37, 9, 12, 38, 12, 2, 8, 38, 9, 0, 22, 24, 10, 6, 2, 44, 25, 2, 18, 62, 12, 8, 4,
+    58, 29, 1, 18, 54, 10, 4, 0, 84, 67, 25, 2, 30, 6, 4, 3, 126, 127, 123, 9, 1, 14, 1, 8,
+    16, 117, 111, 63, 5, 8, 2, 24, 24, 101, 59, 17, 18, 8, 2, 21, 88, 93, 39, 1, 30, 6, 2, 25,
+    50, 51, 17, 4, 28, 16, 4, 13, 30, 29, 13, 1, 30, 6, 2, 1, 0, 65, 29, 1, 18, 8, 0, 8,
+    74, 25, 19, 9, 22, 12, 2, 8, 84, 51, 13, 9, 24, 8, 4, 8, 100, 73, 43, 9, 26, 4, 2, 4,
+    126, 111, 65, 43, 6, 6, 2, 0, 126, 127, 127, 127, 5, 8, 0, 8, 24, 125, 115, 17, 0, 8, 2, 25,
+    120, 127, 121, 15, 2, 6, 2, 17, 74, 67, 65, 17, 8, 12, 1, 13, 50, 89, 35, 1, 0, 16, 4, 9,
+    50, 25, 1, 23, 1, 16, 2, 8, 9, 99, 67, 39, 5, 12, 2, 12, 124, 67, 67, 51, 11, 16, 8, 20,
+    124, 121, 43, 51, 9, 14, 4, 16, 126, 127, 65, 71, 11, 0, 2, 16, 126, 127, 127, 125, 15, 6, 4, 24,
+    126, 127, 127, 127, 21, 10, 0, 18, 126, 127, 127, 127, 21, 10, 2, 2, 126, 127, 127, 123, 9, 0, 2, 1,
+    126, 127, 65, 43, 5, 0, 1, 1, 126, 125, 35, 25, 7, 12, 8, 17, 110, 39, 9, 51, 7, 28, 3, 17,
+    13, 75, 73, 51, 11, 12, 2, 13, 24, 51, 13, 51, 9, 13, 2, 12, 62, 51, 75, 39, 7, 30, 12, 9,
+    80, 127, 77, 53, 7, 2, 4, 17, 62, 127, 105, 51, 5, 6, 2, 13, 34, 127, 125, 85, 13, 4, 2, 25,
+    126, 127, 127, 123, 9, 4, 1, 0, 126, 127, 107, 65, 0, 8, 2, 9, 126, 113, 65, 25, 8, 8, 2, 3,
+    124, 101, 17, 25, 2, 8, 2, 3, 84, 25, 41, 35, 2, 2, 2, 9, 0, 99, 75, 31, 2, 0, 4, 15,
+    38, 49, 33, 17, 2, 8, 8, 3, 50, 71, 41, 17, 6, 2, 4, 9, 54, 105, 49, 25, 8, 6, 0, 9,
+    34, 125, 105, 59, 1, 0, 0, 17, 42, 125, 123, 111, 15, 18, 2, 25, 126, 127, 121, 51, 9, 12, 2, 0,
+    126, 123, 73, 21, 4, 12, 6, 2, 104, 73, 43, 3, 22, 14, 2, 0, 76, 53, 13, 0, 18, 12, 2, 3,
+    70, 17, 17, 1, 38, 8, 4, 9, 0, 65, 25, 1, 12, 8, 2, 13, 38, 29, 9, 6, 32, 16, 12, 3,
+    42, 49, 17, 2, 26, 12, 8, 1, 24, 75, 33, 3, 24, 10, 4, 1, 54, 121, 59, 43, 1, 10, 0, 17,
+    8, 101, 105, 49, 13, 8, 0, 25, 126, 121, 43, 49, 15, 12, 1, 12, 106, 75, 25, 17, 6, 8, 2, 0,
+    74, 51, 23, 0, 24, 10, 8, 2, 64, 35, 3, 12, 46, 12, 12, 3, 62, 23, 5, 9, 12, 4, 8, 9,
+    1, 35, 1, 10, 24, 8, 10, 17, 36, 19, 1, 8, 22, 12, 0, 5, 24, 45, 9, 0, 24, 10, 2, 1,
+    62, 51, 13, 0, 18, 10, 2, 3, 80, 119, 65, 35, 1, 14, 0, 25, 8, 89, 45, 33, 1, 8, 6, 3,
+    122, 61, 65, 17, 9, 8, 4, 3, 106, 41, 49, 29, 6, 16, 2, 0, 76, 31, 29, 6, 12, 2, 2, 0,
+    60, 27, 9, 4, 18, 10, 4, 1, 30, 9, 0, 2, 8, 4, 8, 3, 12, 5, 13, 12, 6, 14, 6, 39,
+    1, 3, 5, 3, 10, 34, 4, 1, 46, 23, 3, 0, 26, 6, 6, 11, 38, 47, 25, 9, 10, 8, 2, 13,
+    70, 75, 35, 1, 10, 10, 2, 11, 1, 125, 41, 59, 0, 22, 5, 13, 24, 127, 125, 75, 13, 4, 1, 1,
+    24, 87, 75, 65, 1, 8, 2, 3, 42, 73, 51, 13, 0, 4, 2, 0, 34, 73, 1, 9, 5, 10, 6, 0,
+    24, 9, 31, 31, 7, 8, 1, 5, 3, 75, 63, 39, 1, 2, 0, 43, 8, 9, 17, 19, 6, 0, 2, 21,
+    22, 43, 1, 3, 18, 12, 0, 35, 20, 65, 35, 13, 8, 16, 2, 35, 34, 109, 75, 63, 2, 8, 6, 51,
+    3, 123, 89, 75, 21, 2, 8, 41, 46, 125, 81, 67, 11, 8, 0, 9, 34, 73, 39, 25, 1, 12, 2, 1,
+    54, 43, 25, 9, 18, 6, 4, 9, 46, 25, 13, 3, 6, 6, 4, 13, 8, 13, 17, 25, 6, 12, 8, 21,
+    30, 13, 17, 9, 10, 0, 1, 9, 24, 5, 11, 8, 26, 12, 0, 9, 52, 25, 5, 4, 32, 12, 0, 13,
+    54, 21, 13, 9, 30, 12, 2, 11, 94, 35, 39, 19, 6, 6, 4, 25, 126, 9, 123, 93, 13, 5, 6, 9,
+    34, 127, 81, 61, 11, 8, 0, 2, 48, 87, 47, 25, 6, 8, 4, 9, 82, 65, 31, 9, 14, 8, 6, 13,
+    42, 47, 13, 2, 16, 8, 4, 25, 52, 25, 5, 1, 32, 12, 2, 9, 24, 65, 3, 0, 8, 6, 2, 1,
+    50, 19, 4, 12, 26, 14, 12, 3, 54, 31, 0, 10, 36, 14, 8, 9, 66, 41, 15, 1, 20, 14, 2, 11,
+    116, 67, 39, 25, 2, 6, 0, 27, 126, 89, 33, 9, 11, 12, 12, 0, 30, 123, 85, 43, 5, 8, 4, 0,
+    58, 103, 65, 25, 8, 6, 2, 9, 66, 87, 53, 1, 20, 8, 2, 17, 70, 75, 25, 1, 12, 8, 4, 15,
+    56, 21, 17, 0, 18, 6, 2, 3, 12, 65, 31, 0, 12, 12, 0, 2, 72, 29, 1, 4, 24, 22, 6, 9,
+    76, 51, 17, 1, 16, 12, 12, 1, 70, 59, 23, 1, 24, 10, 2, 1, 102, 107, 47, 21, 8, 12, 2, 13,
+    126, 127, 125, 31, 7, 4, 2, 0, 16, 109, 79, 49, 3, 14, 2, 1, 50, 127, 109, 41, 4, 6, 2, 17,
+    122, 119, 65, 19, 18, 8, 2, 13, 70, 69, 25, 13, 16, 8, 4, 3, 54, 29, 17, 5, 18, 8, 0, 1,
+    8, 85, 49, 25, 6, 2, 4, 8, 58, 39, 25, 9, 16, 8, 6, 2, 84, 65, 31, 13, 20, 4, 2, 4,
+    126, 99, 49, 17, 14, 6, 4, 1, 126, 127, 93, 49, 0, 8, 2, 1, 126, 127, 127, 121, 7, 4, 2, 8,
+    30, 127, 125, 97, 3, 6, 2, 21, 120, 127, 127, 99, 5, 2, 2, 17, 84, 127, 99, 73, 7, 6, 2, 13,
+    84, 115, 65, 25, 1, 8, 0, 13, 42, 49, 55, 35, 1, 16, 6, 9, 3, 99, 85, 65, 9, 10, 0, 20,
+    122, 75, 97, 67, 13, 16, 0, 38, 126, 117, 75, 81, 15, 8, 0, 24, 126, 127, 127, 85, 13, 2, 2, 28,
+    126, 127, 127, 125, 21, 2, 0, 24, 126, 127, 127, 127, 23, 10, 0, 38, 126, 127, 127, 127, 21, 2, 0, 12,
+    126, 127, 127, 103, 7, 4, 2, 6, 126, 127, 127, 35, 3, 12, 1, 1, 126, 127, 51, 35, 9, 4, 0, 9,
+    104, 31, 39, 43, 13, 1, 0, 9, 31, 81, 93, 65, 13, 2, 1, 21, 8, 31, 43, 25, 3, 0, 1, 13,
+    24, 51, 31, 19, 5, 0, 2, 13, 42, 123, 87, 55, 7, 20, 2, 11, 46, 127, 127, 65, 7, 4, 2, 25,
+    20, 127, 113, 101, 15, 0, 1, 31, 126, 127, 127, 125, 19, 10, 0, 16, 126, 127, 127, 99, 5, 2, 0, 2,
+    126, 127, 125, 47, 2, 8, 3, 8, 124, 77, 49, 13, 1, 4, 4, 12, 60, 9, 17, 33, 1, 16, 0, 8,
+    17, 85, 73, 51, 1, 6, 8, 3, 8, 21, 53, 11, 1, 12, 10, 2, 42, 65, 49, 29, 2, 16, 12, 25,
+    64, 125, 59, 47, 3, 10, 0, 35, 24, 125, 125, 65, 11, 8, 0, 65, 58, 127, 127, 113, 21, 8, 2, 41,
+    126, 127, 127, 75, 15, 8, 2, 12, 126, 127, 125, 63, 3, 8, 0, 8, 126, 125, 63, 43, 2, 12, 0, 12,
+    118, 125, 21, 15, 8, 12, 0, 2, 42, 33, 13, 8, 8, 20, 4, 12, 0, 59, 29, 25, 0, 8, 0, 29,
+    0, 9, 13, 2, 24, 32, 1, 1, 50, 81, 55, 2, 8, 28, 14, 31, 8, 75, 35, 25, 0, 22, 4, 51,
+    50, 87, 125, 43, 11, 14, 3, 57, 64, 127, 127, 43, 21, 1, 0, 25, 126, 127, 55, 73, 13, 12, 2, 16,
+    126, 127, 99, 73, 5, 8, 1, 18, 100, 55, 49, 11, 6, 12, 2, 26, 104, 77, 25, 13, 14, 1, 10, 12,
+    38, 1, 2, 4, 0, 8, 16, 12, 5, 65, 17, 13, 9, 4, 2, 19, 28, 17, 25, 9, 1, 8, 8, 39,
+    1, 43, 19, 13, 1, 12, 4, 21, 42, 51, 25, 13, 1, 2, 8, 31, 34, 125, 125, 93, 19, 40, 0, 55,
+    34, 127, 125, 51, 23, 14, 9, 41, 126, 51, 125, 125, 21, 8, 5, 24, 126, 123, 125, 65, 1, 2, 1, 0,
+    126, 49, 69, 31, 4, 36, 9, 22, 74, 15, 6, 14, 0, 0, 8, 20, 8, 17, 9, 15, 0, 42, 34, 8,
+    3, 1, 1, 13, 1, 22, 2, 25, 21, 12, 31, 43, 1, 26, 0, 13, 22, 1, 9, 35, 6, 4, 2, 35,
+    42, 65, 125, 25, 6, 24, 1, 33, 34, 83, 125, 43, 11, 29, 3, 51, 9, 0, 0, 0, 0, 0, 0, 0,
+    8, 127, 127, 125, 23, 3, 1, 12, 88, 127, 127, 121, 11, 1, 0, 0, 104, 127, 127, 25, 9, 12, 1, 9,
+    54, 125, 15, 25, 13, 12, 8, 1, 30, 1, 71, 81, 13, 8, 3, 0, 9, 117, 105, 81, 13, 1, 0, 89,
+    2, 28, 35, 63, 5, 10, 3, 55, 50, 119, 19, 19, 7, 16, 11, 39, 34, 117, 125, 27, 8, 8, 1, 55,
+    42, 127, 127, 125, 3, 0, 6, 97, 1, 127, 125, 127, 23, 9, 4, 97, 50, 125, 125, 97, 15, 0, 0, 17,
+    122, 127, 125, 89, 5, 8, 9, 31, 122, 127, 123, 9, 11, 2, 0, 13, 108, 55, 23, 49, 15, 8, 4, 13,
+    8, 31, 65, 125, 13, 0, 6, 29, 24, 9, 89, 117, 9, 8, 1, 5, 24, 0, 9, 19, 15, 8, 14, 13,
+    70, 25, 1, 41, 5, 12, 1, 51, 126, 121, 125, 8, 5, 43, 7, 89, 126, 81, 125, 125, 13, 48, 0, 81,
+    126, 9, 89, 127, 19, 28, 7, 1, 56, 127, 125, 105, 19, 16, 2, 1, 120, 127, 121, 125, 13, 8, 2, 9,
+    126, 123, 65, 39, 13, 2, 0, 13, 38, 111, 41, 13, 17, 4, 6, 13, 38, 51, 41, 63, 21, 20, 2, 17,
+    30, 125, 19, 25, 11, 12, 4, 3, 86, 9, 13, 3, 1, 14, 10, 3, 82, 65, 7, 13, 2, 10, 12, 13,
+    126, 127, 35, 1, 1, 12, 3, 25, 126, 127, 75, 125, 9, 8, 2, 81, 126, 107, 49, 63, 23, 34, 3, 21,
+    38, 127, 103, 119, 15, 8, 1, 0, 120, 127, 127, 101, 15, 8, 2, 13, 42, 125, 95, 35, 3, 8, 0, 13,
+    50, 125, 75, 17, 13, 2, 0, 9, 64, 115, 111, 41, 21, 8, 0, 25, 20, 123, 99, 21, 1, 8, 2, 3,
+    64, 35, 67, 3, 8, 6, 4, 2, 126, 97, 35, 13, 2, 12, 6, 7, 126, 121, 117, 13, 0, 4, 4, 9,
+    126, 127, 125, 55, 7, 0, 4, 29, 126, 127, 127, 89, 11, 12, 8, 25, 44, 127, 127, 123, 19, 12, 0, 3,
+    86, 127, 127, 97, 15, 6, 0, 13, 88, 127, 127, 51, 13, 12, 2, 17, 108, 123, 93, 43, 13, 16, 2, 13,
+    50, 89, 125, 73, 13, 0, 0, 17, 16, 125, 125, 81, 3, 4, 2, 2, 86, 13, 75, 75, 1, 2, 8, 9,
+    126, 125, 49, 39, 2, 2, 4, 2, 126, 127, 127, 43, 1, 0, 4, 3, 126, 127, 127, 115, 5, 0, 0, 13,
+    126, 127, 127, 127, 5, 2, 2, 8, 46, 127, 127, 123, 21, 4, 0, 31, 104, 127, 127, 127, 23, 4, 0, 19,
+    110, 127, 127, 121, 21, 8, 2, 25, 86, 127, 127, 117, 21, 12, 0, 25, 54, 127, 127, 75, 13, 8, 0, 25,
+    2, 125, 125, 123, 15, 2, 2, 12, 126, 85, 125, 127, 21, 8, 1, 34, 106, 127, 91, 59, 21, 8, 0, 24,
+    126, 127, 127, 125, 21, 8, 2, 24, 126, 127, 127, 127, 21, 6, 0, 24, 126, 127, 127, 127, 23, 4, 0, 24
+};
+}
@@ -0,0 +1,182 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+#include <filesystem>
+// training reads the opening decisions from the codec instrumentation
+#ifndef LLCOMP_STATS
+#define LLCOMP_STATS
+#endif
+#include "llcomp.hpp"
+#include "batch.hpp"
+#define STB_IMAGE_IMPLEMENTATION
+   #define STBI_NO_GIF
+   #define STBI_NO_PSD
+   #define STBI_NO_PIC
+#include "stb_image.h"
+
+// Trains the initial states of the range coders on a corpus. Every image is cut
+// into tiles the size of the small images the tables are meant for, and every
+// tile is coded as an image of its own with each context model, recording what
+// the opening decisions of each state would have cost from every initial state.
+// The cheapest initial states are written as raw tables for `llcompc --states`
+// and as the llcomp_states.hpp header the codec compiles in.
+
+struct Tile {
+    std::vector<uint8_t> pixels;
+    int width;
+    int height;
+    int channels;
+};
+
+// Up to `limit` tiles of `tile_w` x `tile_h` pixels, spread evenly over the image.
+static void cutTiles(const uint8_t* pixels, int width, int height, int channels, int tile_w, int tile_h, size_t limit,
+                     std::vector<Tile>& tiles) {
+    const int cols = std::max(1, width / tile_w);
+    const int rows = std::max(1, height / tile_h);
+    const size_t count = size_t(cols) * rows;
+    const size_t step = std::max<size_t>(1, count / std::max<size_t>(1, limit));
+    for (size_t i = 0, taken = 0; i < count && taken < limit; i += step, ++taken) {
+        const int x0 = int(i % cols) * tile_w;
+        const int y0 = int(i / cols) * tile_h;
+        Tile tile{{}, std::min(tile_w, width - x0), std::min(tile_h, height - y0), channels};
+        for (int y = 0; y < tile.height; ++y) {
+            const uint8_t* row = pixels + (size_t(y0 + y) * width + x0) * channels;
+            tile.pixels.insert(tile.pixels.end(), row, row + size_t(tile.width) * channels);
+        }
+        tiles.push_back(std::move(tile));
+    }
+}
+
+static void writeArray(std::ostream& out, const char* name, const std::vector<uint8_t>& table) {
+    out << "constexpr inline std::array<uint8_t, " << table.size() << "> " << name << " = {";
+    for (size_t i = 0; i < table.size(); ++i) {
+        out << (i % 24 ? " " : "\n    ") << int(table[i]) << (i + 1 < table.size() ? "," : "");
+    }
+    out << "\n};\n";
+}
+
+int main(int argc, char** argv) {
+    int tile_w = 64, tile_h = 64;
+    int window = 32;
+    uint32_t min_slices = 8;
+    size_t tiles_per_image = 64;
+    std::string out_dir;
+    std::string header_path;
+    std::vector<std::string> args;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--tile" && i + 1 < argc) {
+            char sep = 0;
+            std::istringstream size(argv[++i]);
+            size >> tile_w >> sep >> tile_h;
+            if (tile_w < 1 || tile_h < 1) {
+                std::cerr << "Invalid tile size: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--tiles" && i + 1 < argc) {
+            tiles_per_image = size_t(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--window" && i + 1 < argc) {
+            window = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--min-slices" && i + 1 < argc) {
+            min_slices = uint32_t(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--out" && i + 1 < argc) {
+            out_dir = argv[++i];
+        } else if (arg == "--header" && i + 1 < argc) {
+            header_path = argv[++i];
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (args.empty() || (out_dir.empty() && header_path.empty())) {
+        std::cerr << "Usage: " << argv[0] << " [--tile WxH] [--tiles N] [--window N] [--min-slices N] [--out DIR] [--header FILE] <image_path|directory|->..." << std::endl;
+        return 1;
+    }
+
+    std::vector<Tile> tiles;
+    const auto files = llcomp::collectFiles(args, [](const std::filesystem::path& path) {
+        return path.extension() != llcomp::ext;
+    });
+    for (const auto& file : files) {
+        int width, height, channels;
+        auto stb_img = stbi_load(file.c_str(), &width, &height, &channels, 0);
+        if (stb_img == nullptr) {
+            std::cerr << "Skipping " << file << ": " << stbi_failure_reason() << std::endl;
+            continue;
+        }
+        cutTiles(stb_img, width, height, channels, tile_w, tile_h, tiles_per_image, tiles);
+        stbi_image_free(stb_img);
+    }
+    if (tiles.empty()) {
+        std::cerr << "No images to train on" << std::endl;
+        return 1;
+    }
+    std::cout << files.size() << " files, " << tiles.size() << " tiles of " << tile_w << "x" << tile_h << ", window " << window << "\n";
+
+    // every worker codes a share of the tiles into its own stats
+    auto& pool = llcomp::ThreadPool::shared();
+    std::vector<std::vector<uint8_t>> tables(llcomp::models_nb);
+    for (int m = 0; m < llcomp::models_nb; ++m) {
+        const auto model = llcomp::Model(m);
+        std::vector<llcomp::CodecStats> shares(std::min(pool.size(), tiles.size()));
+        pool.parallel_for(shares.size(), [&](size_t share) {
+            llcomp::CodecStats& stats = shares[share];
+            stats.train_window = window;
+            llcomp::EncodeOptions options;
+            options.model = model;
+            options.stats = &stats;
+            llcomp::ThreadPool serial(1);
+            options.pool = &serial;
+            for (size_t i = share; i < tiles.size(); i += shares.size()) {
+                const Tile& tile = tiles[i];
+                llcomp::compressImage(tile.pixels, tile.width, tile.height, tile.channels, options);
+            }
+        });
+        for (size_t i = 1; i < shares.size(); ++i) shares[0].merge(shares[i]);
+        const llcomp::CodecStats& stats = shares[0];
+        tables[m] = llcomp::trainStates(stats, model, 8, min_slices);
+
+        // bits of the opening decisions from state 0 and from the trained states
+        double before = 0, after = 0;
+        for (size_t i = 0; i < tables[m].size() && i < stats.opening_slices.size(); ++i) {
+            before += stats.opening_bits[i * 128];
+            after += stats.opening_bits[i * 128 + tables[m][i]];
+        }
+        std::cout << llcomp::modelName(model) << ": " << stats.bits() / 8 / 1024 << " KiB coded, opening decisions "
+                  << before / 8 / 1024 << " -> " << after / 8 / 1024 << " KiB, "
+                  << std::count_if(tables[m].begin(), tables[m].end(), [](uint8_t x) { return x != 0; }) << " of " << tables[m].size()
+                  << " states trained\n";
+    }
+
+    if (!out_dir.empty()) {
+        std::filesystem::create_directories(out_dir);
+        for (int m = 0; m < llcomp::models_nb; ++m) {
+            const auto path = std::filesystem::path(out_dir) / (std::string(llcomp::modelName(llcomp::Model(m))) + ".states");
+            std::ofstream out(path, std::ios::binary);
+            out.write(reinterpret_cast<const char*>(tables[m].data()), std::streamsize(tables[m].size()));
+            if (!out) {
+                std::cerr << "Error writing " << path.string() << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (!header_path.empty()) {
+        std::ofstream out(header_path);
+        out << "#pragma once\n#include <array>\n#include <cstdint>\n\n"
+            << "// Initial states of the range coders, generated by llcomp_train from " << tiles.size() << " tiles of "
+            << tile_w << "x" << tile_h << " pixels\n// with a window of " << window << " decisions; see llcomp::trainedStates().\n\n"
+            << "namespace llcomp {\n";
+        writeArray(out, "trained_tiny_states", tables[int(llcomp::Model::Tiny)]);
+        out << "\n";
+        writeArray(out, "trained_small_states", tables[int(llcomp::Model::Small)]);
+        out << "}\n";
+        if (!out) {
+            std::cerr << "Error writing " << header_path << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -2,42 +2,215 @@
 #include <string>
 #include <cassert>
 #include <fstream>
+#include <sstream>
 #include <vector>
+#include <cstdlib>
 #include "llcomp.hpp"
+#include "mapped_file.hpp"
+#include "batch.hpp"
 #define STB_IMAGE_IMPLEMENTATION
    #define STBI_NO_GIF
    #define STBI_NO_PSD
    #define STBI_NO_PIC
 #include "stb_image.h"
 
+// Binary PGM/PPM/PAM header. 8-bit samples of those files are mapped and
+// compressed in place, without decoding the image into memory first.
+static bool readPnmHeader(std::istream& in, int& width, int& height, int& channels, int& maxval) {
+    auto token = [&]() {
+        std::string s;
+        while (in >> s && s[0] == '#') {
+            std::getline(in, s);
+        }
+        return s;
+    };
+    const std::string magic = token();
+    maxval = 0;
+    if (magic == "P5" || magic == "P6") {
+        channels = magic == "P5" ? 1 : 3;
+        width = std::stoi(token());
+        height = std::stoi(token());
+        maxval = std::stoi(token());
+    } else if (magic == "P7") {
+        channels = 0;
+        for (std::string key = token(); key != "ENDHDR"; key = token()) {
+            if (!in) return false;
+            if (key == "WIDTH") width = std::stoi(token());
+            else if (key == "HEIGHT") height = std::stoi(token());
+            else if (key == "DEPTH") channels = std::stoi(token());
+            else if (key == "MAXVAL") maxval = std::stoi(token());
+            else if (key == "TUPLTYPE") token();
+        }
+    } else {
+        return false;
+    }
+    in.get(); // single whitespace before the raster
+    return in && maxval >= 255 && maxval <= 65535 && channels >= 1 && channels <= 4;
+}
+
+// Bits needed for samples up to `maxval`, at least 9 for 16-bit PNM samples.
+static int pnmBitDepth(int maxval) {
+    int depth = 9;
+    while (maxval >> depth) ++depth;
+    return depth;
+}
+
+// Compresses one file to <file>.llcomp. With a context, slices are coded on
+// the calling thread with its reused state; otherwise they run on the pool.
+// 16-bit images are coded at `options.bit_depth` when it is above 8, otherwise
+// at the depth of the PNM maxval, or 16.
+static llcomp::BatchResult compressFile(const std::string& filename, llcomp::EncodeOptions options, llcomp::CodecContext* context,
+                                        llcomp::StatsFormat stats_format) {
+    int width = 0, height = 0, channels = 0, maxval = 0;
+    std::ifstream pnm(filename, std::ios::binary);
+    const bool raw = pnm && readPnmHeader(pnm, width, height, channels, maxval);
+    const size_t raster = raw ? size_t(pnm.tellg()) : 0;
+    pnm.close();
+
+    // 8-bit PNM samples are compressed straight from the mapped file, 16-bit ones are
+    // byte swapped first and other formats come from the buffer stb decodes them into
+    llcomp::MappedFile input;
+    std::unique_ptr<uint8_t, void (*)(void*)> image(nullptr, stbi_image_free);
+    std::unique_ptr<uint16_t, void (*)(void*)> image16(nullptr, stbi_image_free);
+    std::vector<uint16_t> samples;
+    const uint8_t* pixels = nullptr;
+    const uint16_t* pixels16 = nullptr;
+    int file_depth = 8;
+    if (raw) {
+        input = llcomp::MappedFile::openRead(filename);
+        const size_t sample_size = maxval > 255 ? 2 : 1;
+        if (input.size() - raster < size_t(width) * height * channels * sample_size) {
+            throw std::runtime_error("Truncated image data");
+        }
+        if (maxval > 255) {
+            const uint8_t* p = input.data() + raster;
+            samples.resize(size_t(width) * height * channels);
+            for (size_t i = 0; i < samples.size(); ++i) samples[i] = uint16_t(p[2 * i] << 8 | p[2 * i + 1]);
+            pixels16 = samples.data();
+            file_depth = pnmBitDepth(maxval);
+        } else {
+            pixels = input.data() + raster;
+        }
+    } else if (stbi_is_16_bit(filename.c_str())) {
+        image16.reset(stbi_load_16(filename.c_str(), &width, &height, &channels, 0));
+        if (image16 == nullptr) {
+            throw std::runtime_error(std::string("Error loading image: ") + stbi_failure_reason());
+        }
+        pixels16 = image16.get();
+        file_depth = 16;
+    } else {
+        image.reset(stbi_load(filename.c_str(), &width, &height, &channels, 0));
+        if (image == nullptr) {
+            throw std::runtime_error(std::string("Error loading image: ") + stbi_failure_reason());
+        }
+        pixels = image.get();
+    }
+    options.bit_depth = pixels16 ? (options.bit_depth > 8 ? options.bit_depth : file_depth) : 8;
+
+    // the output is mapped at its worst-case size, coded in place, then cut down
+    const std::string outputFile = filename + llcomp::ext;
+    auto output = llcomp::MappedFile::create(outputFile, llcomp::compressBound(width, height, channels, options));
+    llcomp::CodecStats stats;
+    if (stats_format != llcomp::StatsFormat::None) options.stats = &stats;
+    size_t size;
+    if (pixels16) {
+        // a context codes 8-bit samples only; a pool without workers keeps the file on this thread
+        llcomp::ThreadPool serial(1);
+        if (context) options.pool = &serial;
+        size = llcomp::compressInto(pixels16, width, height, channels, output.data(), output.size(), options);
+    } else {
+        size = context ? context->compressInto(pixels, width, height, channels, output.data(), output.size(), options)
+                       : llcomp::compressInto(pixels, width, height, channels, output.data(), output.size(), options);
+    }
+    output.truncate(size, outputFile);
+    if (stats_format != llcomp::StatsFormat::None) llcomp::printStats(filename, stats, stats_format);
+    return {uint64_t(width) * height * channels * (pixels16 ? 2 : 1), size};
+}
 
 int main(int argc, char** argv) {
     // if (llcomp::binarization::ilog2_32<0>(uint32_t{1}) == 0) {
     //     std::cerr << "Unsafe behavior is enabled" << std::endl;
     //     return;
     // }
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <image_path>" << std::endl;
-        return 1;
+    llcomp::EncodeOptions options;
+    std::vector<std::string> args;
+    unsigned jobs = 0;
+    llcomp::StatsFormat stats_format = llcomp::StatsFormat::None;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--slices" && i + 1 < argc) {
+            char sep = 0;
+            std::istringstream grid(argv[++i]);
+            if (!(grid >> options.slice_cols >> sep >> options.slice_rows) || sep != 'x') {
+                std::cerr << "Invalid slice grid: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--model" && i + 1 < argc) {
+            const std::string name = argv[++i];
+            for (int m = 0; m < llcomp::models_nb; ++m) {
+                if (name == llcomp::modelName(llcomp::Model(m))) options.model = llcomp::Model(m);
+            }
+            if (!options.model) {
+                std::cerr << "Unknown context model: " << name << std::endl;
+                return 1;
+            }
+        } else if (arg == "--wide") {
+            options.coder = llcomp::Coder::WideRange;
+        } else if (arg == "--fast") {
+            options.coder = llcomp::Coder::GolombRice;
+        } else if (arg == "--wavefront") {
+            options.wavefront = true;
+        } else if (arg == "--planar") {
+            options.planar = true;
+        } else if (arg == "--adaptive") {
+            options.adaptive_predictor = true;
+        } else if (arg == "--states" && i + 1 < argc) {
+            if (!llcomp::parseStates(argv[++i], options)) {
+                std::cerr << "Cannot read initial states: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--depth" && i + 1 < argc) {
+            options.bit_depth = std::atoi(argv[++i]);
+            if (options.bit_depth < 9 || options.bit_depth > 16) {
+                std::cerr << "Invalid bit depth for 16-bit images: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            jobs = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--stats" || arg == "--stats=json") {
+            if (!llcomp::stats_enabled) {
+                std::cerr << "--stats needs a build with LLCOMP_STATS defined" << std::endl;
+                return 1;
+            }
+            stats_format = arg == "--stats" ? llcomp::StatsFormat::Text : llcomp::StatsFormat::Json;
+        } else {
+            args.push_back(arg);
+        }
     }
-    const char* filename = argv[1];
-    int width, height, channels;
-    auto stb_img = stbi_load(argv[1] , &width, &height, &channels, 0);
-    if (stb_img == nullptr) {
-        std::cerr << "Error loading image: " << stbi_failure_reason() << std::endl;
+    if (args.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--slices COLSxROWS] [--model tiny|small|large] [--wide|--fast] [--wavefront|--planar] [--adaptive] [--states default|trained|FILE] [--depth 9..16] [--jobs N] [--stats[=json]] <image_path|directory|->..." << std::endl;
         return 1;
     }
-    std::vector<uint8_t> rgb = std::vector<uint8_t>(stb_img, stb_img + width * height * channels);
-    stbi_image_free(stb_img);
-
-    std::vector<uint8_t> compressed = llcomp::compressImage(rgb, width, height, channels);
-    std::string outputFile = std::string(filename) + llcomp::ext;
-    std::ofstream outFile(outputFile, std::ios::binary);
-    if (!outFile) {
-        std::cerr << "Error opening output file: " << outputFile << std::endl;
+
+    // several files, a directory or a list on stdin: one file per worker, each
+    // with its own reused codec state
+    if (args.size() > 1 || args[0] == "-" || std::filesystem::is_directory(args[0])) {
+        const auto files = llcomp::collectFiles(args, [](const std::filesystem::path& path) {
+            return path.extension() != llcomp::ext;
+        });
+        llcomp::ThreadPool own(jobs);
+        llcomp::ThreadPool& pool = jobs ? own : llcomp::ThreadPool::shared();
+        return llcomp::runBatch(files, pool, [&](const std::string& file) {
+            thread_local llcomp::CodecContext context;
+            return compressFile(file, options, &context, stats_format);
+        }) ? 1 : 0;
+    }
+
+    try {
+        compressFile(args[0], options, nullptr, stats_format);
+    } catch (const std::exception& e) {
+        std::cerr << "Error compressing image: " << e.what() << std::endl;
         return 1;
     }
-    outFile.write(reinterpret_cast<const char*>(compressed.data()), compressed.size());
-    outFile.close();
     return 0;
 }
@@ -1,34 +1,150 @@
 #include <iostream>
 #include <string>
 #include <cassert>
-#include <fstream>
+#include <sstream>
 #include <vector>
+#include <cstdlib>
+#include <optional>
 #include "llcomp.hpp"
+#include "mapped_file.hpp"
+#include "batch.hpp"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
+// Decompresses one file to <file>.png, or to a PGM/PPM/PAM file with `pnm`. With a
+// context, slices are decoded on the calling thread with its reused state;
+// otherwise they run on the pool. Streams above 8 bits are always written as
+// PNM, since stb_image_write has no 16-bit PNG. A `crop` or a `thumbnail` size
+// only decodes the slices under the crop, downscaled to fit the thumbnail.
+static llcomp::BatchResult decompressFile(const std::string& filename, bool pnm, llcomp::CodecContext* context,
+                                          llcomp::StatsFormat stats_format, std::optional<llcomp::Rect> crop = {},
+                                          uint32_t thumbnail = 0) {
+    // the stream is decoded straight from the mapped file
+    const auto input = llcomp::MappedFile::openRead(filename);
+    const llcomp::Header header = llcomp::readHeader(input.data(), input.size());
+    const bool region = crop || thumbnail;
+    const llcomp::Rect rect = crop ? *crop : llcomp::Rect{0, 0, int(header.width), int(header.height)};
+    const int scale = thumbnail ? llcomp::thumbnailScale(rect.width, rect.height, thumbnail) : 1;
+    if (region) llcomp::checkRegion(header, rect, scale);
+    const int width = region ? (rect.width + scale - 1) / scale : int(header.width);
+    const int height = region ? (rect.height + scale - 1) / scale : int(header.height);
+    const int channels = header.channels;
+    const bool deep = header.bit_depth > 8;
+    const size_t stride = size_t(width) * channels * (deep ? 2 : 1);
+    llcomp::CodecStats stats;
+    llcomp::CodecStats* collect = stats_format != llcomp::StatsFormat::None ? &stats : nullptr;
+    auto decode = [&](uint8_t* pixels, size_t capacity) {
+        if (context && !deep && !region) {
+            context->decompressInto(input.data(), input.size(), pixels, capacity, collect);
+            return;
+        }
+        // a context decodes whole 8-bit images only; a pool without workers keeps the file on this thread
+        llcomp::ThreadPool serial(1);
+        llcomp::ThreadPool* pool = context ? &serial : nullptr;
+        if (region) {
+            llcomp::decompressRegion(input.data(), input.size(), rect, llcomp::OutputLayout{pixels, capacity, stride, 0}, scale, pool,
+                                     collect);
+        } else {
+            llcomp::decompressInto(input.data(), input.size(), pixels, capacity, pool, collect);
+        }
+    };
+
+    if (pnm || deep) {
+        // PGM/PPM/PAM hold raw samples, so 8-bit images are decoded into the mapped output file
+        std::string outputFile = filename + (channels == 1 ? ".pgm" : channels == 3 ? ".ppm" : ".pam");
+        const int maxval = (1 << header.bit_depth) - 1;
+        std::ostringstream pnmHeader;
+        if (channels == 1 || channels == 3) {
+            pnmHeader << (channels == 1 ? "P5" : "P6") << "\n" << width << " " << height << "\n" << maxval << "\n";
+        } else {
+            pnmHeader << "P7\nWIDTH " << width << "\nHEIGHT " << height << "\nDEPTH " << channels
+                      << "\nMAXVAL " << maxval << "\nTUPLTYPE " << (channels == 2 ? "GRAYSCALE_ALPHA" : "RGB_ALPHA") << "\nENDHDR\n";
+        }
+        const std::string text = pnmHeader.str();
+        auto output = llcomp::MappedFile::create(outputFile, text.size() + stride * height);
+        std::copy(text.begin(), text.end(), output.data());
+        if (deep) {
+            // 16-bit PNM samples are big endian
+            std::vector<uint16_t> samples(stride / 2 * height);
+            decode(reinterpret_cast<uint8_t*>(samples.data()), stride * height);
+            uint8_t* p = output.data() + text.size();
+            for (size_t i = 0; i < samples.size(); ++i) {
+                p[2 * i] = uint8_t(samples[i] >> 8);
+                p[2 * i + 1] = uint8_t(samples[i]);
+            }
+        } else {
+            decode(output.data() + text.size(), output.size() - text.size());
+        }
+        // moves the decoded file over any previous output
+        output.truncate(output.size(), outputFile);
+    } else {
+        std::vector<uint8_t> pixels(stride * height);
+        decode(pixels.data(), pixels.size());
+        std::string outputFile = filename + ".png";
+        if  (!stbi_write_png(outputFile.c_str(), width, height, channels, pixels.data(), stride)) {
+            throw std::runtime_error("Error writing output file: " + outputFile);
+        }
+    }
+    if (collect) llcomp::printStats(filename, stats, stats_format);
+    return {uint64_t(stride) * height, input.size()};
+}
 
 int main(int argc, char** argv) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <image_path>" << std::endl;
-        return 1;
+    bool pnm = false;
+    std::optional<llcomp::Rect> crop;
+    uint32_t thumbnail = 0;
+    std::vector<std::string> args;
+    unsigned jobs = 0;
+    llcomp::StatsFormat stats_format = llcomp::StatsFormat::None;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--pnm") {
+            pnm = true;
+        } else if (arg == "--crop" && i + 1 < argc) {
+            llcomp::Rect rect{};
+            char comma = 0, sep = 0, x = 0;
+            std::istringstream spec(argv[++i]);
+            if (!(spec >> rect.x >> comma >> rect.y >> sep >> rect.width >> x >> rect.height) || comma != ',' || sep != ',' ||
+                x != 'x') {
+                std::cerr << "Invalid crop: " << argv[i] << std::endl;
+                return 1;
+            }
+            crop = rect;
+        } else if (arg == "--thumbnail" && i + 1 < argc) {
+            thumbnail = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            jobs = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--stats" || arg == "--stats=json") {
+            if (!llcomp::stats_enabled) {
+                std::cerr << "--stats needs a build with LLCOMP_STATS defined" << std::endl;
+                return 1;
+            }
+            stats_format = arg == "--stats" ? llcomp::StatsFormat::Text : llcomp::StatsFormat::Json;
+        } else {
+            args.push_back(arg);
+        }
     }
-    const char* filename = argv[1];
-    std::ifstream inFile(filename, std::ios::binary);
-    if (!inFile) {
-        std::cerr << "Error opening input file: " << filename << std::endl;
+    if (args.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--pnm] [--crop X,Y,WxH] [--thumbnail SIZE] [--jobs N] [--stats[=json]] <image_path|directory|->..." << std::endl;
         return 1;
     }
-    std::vector<uint8_t> compressed((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
-    inFile.close();
 
-    try {
-        auto [pixels, width, height, channels] = llcomp::decompressImage(compressed);
+    // several files, a directory or a list on stdin: one file per worker, each
+    // with its own reused codec state
+    if (args.size() > 1 || args[0] == "-" || std::filesystem::is_directory(args[0])) {
+        const auto files = llcomp::collectFiles(args, [](const std::filesystem::path& path) {
+            return path.extension() == llcomp::ext;
+        });
+        llcomp::ThreadPool own(jobs);
+        llcomp::ThreadPool& pool = jobs ? own : llcomp::ThreadPool::shared();
+        return llcomp::runBatch(files, pool, [&](const std::string& file) {
+            thread_local llcomp::CodecContext context;
+            return decompressFile(file, pnm, &context, stats_format, crop, thumbnail);
+        }) ? 1 : 0;
+    }
 
-        std::string outputFile = std::string(filename) + ".png";
-        if  (!stbi_write_png(outputFile.c_str(), width, height, channels, pixels.data(), width * channels)) {
-            std::cerr << "Error writing output file: " << outputFile << std::endl;
-        }
+    try {
+        decompressFile(args[0], pnm, nullptr, stats_format, crop, thumbnail);
     } catch (const std::exception& e) {
         std::cerr << "Error decompressing image: " << e.what() << std::endl;
         return 1;
@@ -0,0 +1,194 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace llcomp {
+
+/**
+ * @brief File mapped into memory, used by the command line tools for zero-copy I/O.
+ *
+ * openRead() maps an existing file read-only. create() makes a file of a given size and
+ * maps it read-write, so a codec can write its output straight into the page cache;
+ * truncate() then cuts the file down to the bytes actually written.
+ *
+ * create() writes to `<path>.tmp`, which truncate() renames over `path`. A file closed
+ * before that, e.g. because coding threw, is removed, so a failed call never leaves a
+ * partial output behind nor replaces an existing one.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+            std::swap(file, other.file);
+            std::swap(temp, other.temp);
+#ifdef _WIN32
+            std::swap(mapping, other.mapping);
+#endif
+        }
+        return *this;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() { close(); }
+
+    static MappedFile openRead(const std::string& path) {
+        MappedFile f;
+#ifdef _WIN32
+        f.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (f.file == INVALID_HANDLE_VALUE) fail("Error opening input file", path);
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(f.file, &size)) fail("Error reading input file", path);
+        f.size_ = static_cast<size_t>(size.QuadPart);
+#else
+        f.file = ::open(path.c_str(), O_RDONLY);
+        if (f.file < 0) fail("Error opening input file", path);
+        struct stat st;
+        if (fstat(f.file, &st) != 0) fail("Error reading input file", path);
+        f.size_ = static_cast<size_t>(st.st_size);
+#endif
+        f.map(false, path);
+        return f;
+    }
+
+    static MappedFile create(const std::string& path, size_t size) {
+        MappedFile f;
+        const std::string temp = path + ".tmp";
+#ifdef _WIN32
+        f.file = CreateFileA(temp.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (f.file == INVALID_HANDLE_VALUE) fail("Error opening output file", temp);
+#else
+        f.file = ::open(temp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (f.file < 0) fail("Error opening output file", temp);
+#endif
+        f.temp = temp;
+        f.size_ = size;
+        f.resizeFile(size, path);
+        f.map(true, path);
+        return f;
+    }
+
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    /**
+     * @brief Unmaps a file made by create(), cuts it to its first `size` bytes and moves it
+     *        to `path`.
+     */
+    void truncate(size_t size, const std::string& path) {
+        unmap();
+        size_ = size;
+        resizeFile(size, path);
+        closeFile();
+#ifdef _WIN32
+        if (!MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) fail("Error writing output file", path);
+#else
+        if (std::rename(temp.c_str(), path.c_str()) != 0) fail("Error writing output file", path);
+#endif
+        temp.clear();
+    }
+
+private:
+    [[noreturn]] static void fail(const char* what, const std::string& path) {
+#ifdef _WIN32
+        throw std::runtime_error(std::string(what) + ": " + path);
+#else
+        throw std::runtime_error(std::string(what) + ": " + path + " (" + std::strerror(errno) + ")");
+#endif
+    }
+
+    void map(bool writable, const std::string& path) {
+        if (size_ == 0) return;
+#ifdef _WIN32
+        mapping = CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) fail("Error mapping file", path);
+        data_ = static_cast<uint8_t*>(MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size_));
+        if (data_ == nullptr) fail("Error mapping file", path);
+#else
+        void* p = mmap(nullptr, size_, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+        if (p == MAP_FAILED) fail("Error mapping file", path);
+        data_ = static_cast<uint8_t*>(p);
+#endif
+    }
+
+    void resizeFile(size_t size, const std::string& path) {
+#ifdef _WIN32
+        LARGE_INTEGER pos;
+        pos.QuadPart = static_cast<LONGLONG>(size);
+        if (!SetFilePointerEx(file, pos, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) fail("Error writing output file", path);
+#else
+        if (ftruncate(file, static_cast<off_t>(size)) != 0) fail("Error writing output file", path);
+#endif
+    }
+
+    void unmap() {
+#ifdef _WIN32
+        if (data_) UnmapViewOfFile(data_);
+        if (mapping) CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        if (data_) munmap(data_, size_);
+#endif
+        data_ = nullptr;
+    }
+
+    void closeFile() {
+#ifdef _WIN32
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (file >= 0) ::close(file);
+        file = -1;
+#endif
+    }
+
+    void close() {
+        unmap();
+        closeFile();
+        // an output that was never truncated is incomplete
+        if (!temp.empty()) {
+#ifdef _WIN32
+            DeleteFileA(temp.c_str());
+#else
+            ::unlink(temp.c_str());
+#endif
+            temp.clear();
+        }
+        size_ = 0;
+    }
+
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    std::string temp; // output of create() until truncate() moves it into place
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int file = -1;
+#endif
+};
+
+} // namespace llcomp